@@ -14,11 +14,30 @@
 #include "textbox.h"
 #include "statusbar.h"
 #include "panel.h"
+#include "menu.h"
 #include "msg_dlg.h"
 #include "file_ops.h"
 #include "file_dlg.h"
+#include "hex.h"
 #include "actions.h"
 
+#define MIN_REFLOW_COLS 8 // narrowest width paragraphs are reflowed to
+
+static uint8_t reflow_cols = REFLOW_COLS;
+
+// ---------------------------------------------------------------------------
+// Returns false, with a warning, while a binary file is shown in hex, as
+// the doc's text and layout actions would write over its blocks in XRAM
+// ---------------------------------------------------------------------------
+static bool TextShown(void)
+{
+    if (HexView()) {
+        UpdateStatusBarMsg("Not available in hex view!", STATUS_WARNING);
+        return false;
+    }
+    return true;
+}
+
 // ---------------------------------------------------------------------------
 // ---------------------------------------------------------------------------
 void FileOpen(void)
@@ -189,6 +208,9 @@ void FileExit(void)
 void EditCut(void)
 {
     CloseAnyPopupMenu();
+    if (!TextShown()) {
+        return;
+    }
     if (!CopyMarkedTextToClipboard()) {
         UpdateStatusBarMsg("Out of memory for Clipboard!", STATUS_ERROR);
     } else {
@@ -202,6 +224,9 @@ void EditCut(void)
 void EditCopy(void)
 {
     CloseAnyPopupMenu();
+    if (!TextShown()) {
+        return;
+    }
     if (!CopyMarkedTextToClipboard()) {
         UpdateStatusBarMsg("Out of memory for Clipboard!", STATUS_ERROR);
     }
@@ -213,10 +238,248 @@ void EditCopy(void)
 void EditPaste(void)
 {
     CloseAnyPopupMenu();
+    if (!TextShown()) {
+        return;
+    }
     if (!PasteTextFromClipboard()) {
         UpdateStatusBarMsg("Paste would exceed row or column limits!", STATUS_WARNING);
     }
 }
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void EditAutoIndent(void)
+{
+    CloseAnyPopupMenu();
+    TheDoc.auto_indent = !TheDoc.auto_indent;
+    UpdateStatusBarMsg(TheDoc.auto_indent ? "Auto indent is on" : "Auto indent is off",
+                       STATUS_INFO);
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void EditMoveLinesUp(void)
+{
+    CloseAnyPopupMenu();
+    if (!TextShown()) {
+        return;
+    }
+    MoveMarkedLines(true);
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void EditMoveLinesDown(void)
+{
+    CloseAnyPopupMenu();
+    if (!TextShown()) {
+        return;
+    }
+    MoveMarkedLines(false);
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void EditDuplicateLines(void)
+{
+    CloseAnyPopupMenu();
+    if (!TextShown()) {
+        return;
+    }
+    if (!DuplicateMarkedLines()) {
+        UpdateStatusBarMsg("Duplicate would exceed row limit!", STATUS_WARNING);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void EditDeleteLines(void)
+{
+    CloseAnyPopupMenu();
+    if (!TextShown()) {
+        return;
+    }
+    DeleteMarkedLines();
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void EditJoinLines(void)
+{
+    CloseAnyPopupMenu();
+    if (!TextShown()) {
+        return;
+    }
+    if (!JoinMarkedLines()) {
+        UpdateStatusBarMsg("Lines can't be joined!", STATUS_WARNING);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void EditReflowLines(void)
+{
+    CloseAnyPopupMenu();
+    if (!TextShown()) {
+        return;
+    }
+    if (!ReflowMarkedLines(reflow_cols)) {
+        UpdateStatusBarMsg("Reflow would exceed row limit!", STATUS_WARNING);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Sets the width paragraphs are reflowed to, to the cursor's column
+// ---------------------------------------------------------------------------
+void EditSetReflowWidth(void)
+{
+    char msg[MAX_STATUS_MSG+1] = {0};
+    CloseAnyPopupMenu();
+    if (!TextShown()) {
+        return;
+    }
+    if (TheDoc.cursor_c < MIN_REFLOW_COLS) {
+        snprintf(msg, MAX_STATUS_MSG, "Reflow width must be at least %u!", MIN_REFLOW_COLS);
+        UpdateStatusBarMsg(msg, STATUS_WARNING);
+    } else {
+        reflow_cols = TheDoc.cursor_c;
+        snprintf(msg, MAX_STATUS_MSG, "Reflow width set to %u", reflow_cols);
+        UpdateStatusBarMsg(msg, STATUS_INFO);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Folds the marked lines, or the block at the cursor, or unfolds it
+// ---------------------------------------------------------------------------
+void EditFoldLines(void)
+{
+    CloseAnyPopupMenu();
+    if (!TextShown()) {
+        return;
+    }
+    if (!FoldMarkedLines()) {
+        UpdateStatusBarMsg("Nothing to fold here!", STATUS_WARNING);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Shows or hides the line number gutter
+// ---------------------------------------------------------------------------
+void ViewLineNumbers(void)
+{
+    CloseAnyPopupMenu();
+    if (!TextShown()) {
+        return;
+    }
+    ShowLineNumbers(TheTextbox->c == 0);
+}
+
+// ---------------------------------------------------------------------------
+// Wraps rows wider than the panes onto the rows below, or clips them again
+// ---------------------------------------------------------------------------
+void ViewSoftWrap(void)
+{
+    CloseAnyPopupMenu();
+    if (!TextShown()) {
+        return;
+    }
+    SetSoftWrap(!SoftWrap());
+    UpdateStatusBarMsg(SoftWrap() ? "Soft wrap is on" : "Soft wrap is off", STATUS_INFO);
+}
+
+// ---------------------------------------------------------------------------
+// Shows or hides the scrollbar
+// ---------------------------------------------------------------------------
+void ViewScrollbar(void)
+{
+    CloseAnyPopupMenu();
+    if (!TextShown()) {
+        return;
+    }
+    ShowScrollbar(!ScrollbarShown());
+}
+
+// ---------------------------------------------------------------------------
+// Splits the textbox into two panes over the doc, or joins them again
+// ---------------------------------------------------------------------------
+void ViewSplit(void)
+{
+    CloseAnyPopupMenu();
+    if (!TextShown()) {
+        return;
+    }
+    SplitTextbox(!TextboxSplit());
+}
+
+// ---------------------------------------------------------------------------
+// Switches between 28 text rows with the 8x16 font and 58 with the 8x8
+// font, laying out the menu, panes and status bar for the new rows
+// ---------------------------------------------------------------------------
+void ViewDenseText(void)
+{
+    uint8_t pane = (TheTextbox == &ThePanes[0]) ? 0 : 1;
+    CloseAnyPopupMenu();
+    if (!TextShown()) {
+        return;
+    }
+    FinishGlide();
+    SetDenseText(font_height() == 16);
+    DrawMainMenu();
+    SplitTextbox(TextboxSplit());
+    ActivatePane(pane);
+    RedrawStatusBar();
+}
+
+// ---------------------------------------------------------------------------
+// Turns smooth scrolling, for paging and the mouse wheel, on or off
+// ---------------------------------------------------------------------------
+void ViewSmoothScroll(void)
+{
+    CloseAnyPopupMenu();
+    SetSmoothScroll(!SmoothScroll());
+    UpdateStatusBarMsg(SmoothScroll() ? "Smooth scrolling is on" : "Smooth scrolling is off",
+                       STATUS_INFO);
+}
+
+// ---------------------------------------------------------------------------
+// Moves the cursor to the other pane, if split
+// ---------------------------------------------------------------------------
+void ViewOtherPane(void)
+{
+    CloseAnyPopupMenu();
+    if (!TextShown()) {
+        return;
+    }
+    ActivatePane((TheTextbox == &ThePanes[0]) ? 1 : 0);
+}
+
+// ---------------------------------------------------------------------------
+// Bookmarks the cursor row. The doc keeps the bookmark on the same text
+// as rows above it are added or deleted.
+// ---------------------------------------------------------------------------
+void EditSetBookmark(uint8_t index)
+{
+    char msg[MAX_STATUS_MSG+1] = {0};
+    if (index < NUM_BOOKMARKS && TextShown()) {
+        TheDoc.bookmarks[index] = TheDoc.cursor_r;
+        snprintf(msg, MAX_STATUS_MSG, "Bookmark %u set at line %u",
+                 index+1, TheDoc.cursor_r+1);
+        UpdateStatusBarMsg(msg, STATUS_INFO);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void EditGotoBookmark(uint8_t index)
+{
+    if (index < NUM_BOOKMARKS && TextShown()) {
+        if (!GotoDocRow(TheDoc.bookmarks[index])) {
+            char msg[MAX_STATUS_MSG+1] = {0};
+            snprintf(msg, MAX_STATUS_MSG, "Bookmark %u is not set", index+1);
+            UpdateStatusBarMsg(msg, STATUS_WARNING);
+        }
+    }
+}
 /*
 // ---------------------------------------------------------------------------
 // ---------------------------------------------------------------------------
@@ -251,3 +514,32 @@ void HelpAbout(void)
         }
     }
 }
+
+// ---------------------------------------------------------------------------
+// Reports the doc statistics, which the doc keeps up to date as it changes
+// ---------------------------------------------------------------------------
+void HelpStatistics(void)
+{
+    msg_dlg_t * msg_dialog = NULL;
+    char msg[MAX_MSG_LEN+1] = {0};
+    uint16_t used = (TheDoc.last_row+1)*DOC_COLS;
+    CloseAnyPopupMenu();
+    if (!TextShown()) {
+        return;
+    }
+    snprintf(msg, MAX_MSG_LEN, "%u lines, %u words, %u chars; %u bytes used, %u free",
+             TheDoc.last_row+1, TheDoc.num_words, TheDoc.num_chars,
+             used, (uint16_t)DOC_ROWS*DOC_COLS - used);
+    msg_dialog = NewMsgDlg(msg, OK, NOP, NOP, NOP);
+    if (msg_dialog != NULL) {
+        uint8_t show_r, show_c;
+        set_popup(msg_dialog);
+        set_popup_type(MSGDIALOG);
+        UpdateTextboxFocus(false);
+        show_r = (canvas_rows()-msg_dialog->panel.h)/2;
+        show_c = (canvas_cols()-msg_dialog->panel.w)/2;
+        if (!ShowMsgDlg(msg_dialog, show_r, show_c)) {
+            DeleteMsgDlg(msg_dialog);
+        }
+    }
+}
@@ -19,10 +19,30 @@ void FileExitYes(void);
 void EditCut(void);
 void EditCopy(void);
 void EditPaste(void);
+void EditAutoIndent(void);
+void EditMoveLinesUp(void);
+void EditMoveLinesDown(void);
+void EditDuplicateLines(void);
+void EditDeleteLines(void);
+void EditJoinLines(void);
+void EditReflowLines(void);
+void EditSetReflowWidth(void);
+void EditFoldLines(void);
+void EditSetBookmark(uint8_t index);
+void EditGotoBookmark(uint8_t index);
+
+void ViewLineNumbers(void);
+void ViewScrollbar(void);
+void ViewSoftWrap(void);
+void ViewSplit(void);
+void ViewDenseText(void);
+void ViewSmoothScroll(void);
+void ViewOtherPane(void);
 /*
 void EditFind(void);
 void EditReplace(void);
 */
 void HelpAbout(void);
+void HelpStatistics(void);
 
 #endif // ACTIONS_H
@@ -16,22 +16,16 @@
 static void DrawButton(button_t * btn)
 {
     if (btn != NULL) {
-        uint8_t c, n, start, len;
+        uint8_t start;
         // draw button background
-        for (c = btn->c; c < btn->c + btn->w; c++) {
-            DrawChar(btn->r, c, ' ',
-                        btn->in_focus ? btn->focus_bg : btn->bg,
-                        btn->in_focus ? btn->focus_fg : btn->fg);
-        }
+        FillSpan(btn->r, btn->c, ' ', btn->w,
+                 btn->in_focus ? btn->focus_bg : btn->bg,
+                 btn->in_focus ? btn->focus_fg : btn->fg);
         // draw the button label
-        len  = strlen(btn->btn_lbl);
         start = btn->c + 1;
-        n = 0;
-        for (c = start; c < (start + len); c++) {
-            DrawChar(btn->r, c, btn->btn_lbl[n++],
-                     btn->in_focus ? btn->focus_bg : btn->bg,
-                     btn->in_focus ? btn->focus_fg : btn->fg);
-        }
+        DrawSpan(btn->r, start, btn->btn_lbl, strlen(btn->btn_lbl),
+                 btn->in_focus ? btn->focus_bg : btn->bg,
+                 btn->in_focus ? btn->focus_fg : btn->fg);
         if (btn->alt_index >= 0) {
             DrawChar(btn->r, start + btn->alt_index, btn->btn_lbl[btn->alt_index],
                      btn->in_focus ? btn->focus_bg : btn->bg, btn->alt_fg);
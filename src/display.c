@@ -11,6 +11,8 @@
 #include "display.h"
 
 static uint16_t canvas_struct = 0xFF00;
+static uint16_t status_struct = 0xFF10;
+static const uint16_t text_struct[NUM_RINGS] = {0xFF60, 0xFF80};
 static uint16_t canvas_data = 0x0000;
 static uint8_t plane = 0;
 static uint8_t canvas_type = 3; // 640x480
@@ -20,23 +22,78 @@ static uint8_t canvas_c = 80;
 static uint8_t canvas_r = 30;
 static uint8_t font_w = 8;
 static uint8_t font_h = 16;
+static uint8_t font_bpp_opt = 10; // 8x16 font at 4bpp
 static int8_t bpp = 4;
 static uint8_t bg_clr = BLACK;
 static uint8_t fg_clr = LIGHT_GRAY;
 
+// Popups are drawn on plane 1, over the text on plane 0, on a canvas just
+// their size, so the text under them is never touched. Cells in the open
+// overlay's rectangle are drawn on it, unless drawing beneath it.
+// Menus bring their own prerendered overlay canvas, dialogs use overlay_data.
+static const uint16_t overlay_struct = 0xFF90;
+static const uint16_t overlay_data = 0xFB00; // to 0xFDFF, OVERLAY_SIZE bytes
+static const uint8_t overlay_plane = 1;
+static uint16_t overlay_addr = 0xFB00; // of the open overlay's cells
+static uint8_t overlay_r = 0;
+static uint8_t overlay_c = 0;
+static uint8_t overlay_w = 0;
+static uint8_t overlay_h = 0; // 0 if no overlay is open
+static bool beneath = false;
+
+// The text rows between the menu and status bar rows form a ring (or two,
+// when split), which scrolls in hardware by moving y_pos_px. A ring shows
+// ring_h rows from display row ring_row, and ring_top is how many rows it
+// is scrolled, so its canvas row ring_top shows at its top. Each ring has
+// one more canvas row than it shows, its margin, just below its bottom row
+// and just above its top one, so a row can be drawn before it scrolls in.
+// Ring i's canvas rows start at canvas_data row ring_data[i], and the
+// status bar row's come after all the rings, at row STATUS_DATA_ROW.
+// The firmware rebases a plane's y_pos_px to the first scanline it is
+// programmed over, so a ring's y_pos_px is -font_h*ring_top, wherever
+// the ring is on the display. The overlay is programmed over all the
+// scanlines, from 0, so its y_pos_px is its display row's scanline.
+#define STATUS_DATA_ROW (canvas_r-1 + NUM_RINGS)
+static uint8_t ring_row[NUM_RINGS] = {1, 0};
+static uint8_t ring_h[NUM_RINGS] = {0, 0}; // ring 1 is unused if 0
+static uint8_t ring_top[NUM_RINGS] = {0, 0};
+static uint8_t ring_data[NUM_RINGS] = {1, 0};
+
 // ---------------------------------------------------------------------------
-// canvas_type = 3 (640x480), font_opt = 1 (8x16), bpp_opt = 2 (4bpp),
-// plane = 0, canvas_struct = 0xFF00, canvas_data = 0x000
+// Sets up text ring i as h display rows from row, with its h+1 canvas rows
+// from canvas_data row data, unscrolled
 // ---------------------------------------------------------------------------
-void InitDisplay(void)
+static void SetRing(uint8_t i, uint8_t row, uint8_t data, uint8_t h)
+{
+    uint16_t ring_struct = text_struct[i];
+    ring_row[i] = row;
+    ring_h[i] = h;
+    ring_top[i] = 0;
+    ring_data[i] = data;
+    xram0_struct_set(ring_struct, vga_mode1_config_t, x_wrap, false);
+    xram0_struct_set(ring_struct, vga_mode1_config_t, y_wrap, true);
+    xram0_struct_set(ring_struct, vga_mode1_config_t, x_pos_px, 0);
+    xram0_struct_set(ring_struct, vga_mode1_config_t, y_pos_px, 0);
+    xram0_struct_set(ring_struct, vga_mode1_config_t, width_chars, canvas_c);
+    xram0_struct_set(ring_struct, vga_mode1_config_t, height_chars, h+1);
+    xram0_struct_set(ring_struct, vga_mode1_config_t, xram_data_ptr, canvas_data + 2*canvas_c*data);
+    xram0_struct_set(ring_struct, vga_mode1_config_t, xram_palette_ptr, 0xFFFF);
+    xram0_struct_set(ring_struct, vga_mode1_config_t, xram_font_ptr, 0xFFFF);
+    xregn(1, 0, 1, 6, 1, font_bpp_opt, ring_struct, plane, font_h*row, font_h*(row+h));
+}
+
+// ---------------------------------------------------------------------------
+// Programs plane 0 for the font's rows: the menu row, the text rows ring
+// and the status bar row, each over its own scanlines
+// ---------------------------------------------------------------------------
+static void SetRows(void)
 {
     uint8_t x_offset = 0;
     uint8_t y_offset = 0;
-    uint8_t font_bpp_opt = 10; // 8x16 font at 4bpp
-
-    // initialize the canvas
-    xregn(1, 0, 0, 1, canvas_type);
+    uint16_t text_top = font_h;
+    uint16_t status_top = font_h * (canvas_r-1);
 
+    // menu row
     xram0_struct_set(canvas_struct, vga_mode1_config_t, x_wrap, false);
     xram0_struct_set(canvas_struct, vga_mode1_config_t, y_wrap, false);
     xram0_struct_set(canvas_struct, vga_mode1_config_t, x_pos_px, x_offset);
@@ -47,29 +104,132 @@ void InitDisplay(void)
     xram0_struct_set(canvas_struct, vga_mode1_config_t, xram_palette_ptr, 0xFFFF);
     xram0_struct_set(canvas_struct, vga_mode1_config_t, xram_font_ptr, 0xFFFF);
 
-    xregn(1, 0, 1, 4, 1, font_bpp_opt, canvas_struct, plane);
+    // status bar row
+    xram0_struct_set(status_struct, vga_mode1_config_t, x_wrap, false);
+    xram0_struct_set(status_struct, vga_mode1_config_t, y_wrap, true);
+    xram0_struct_set(status_struct, vga_mode1_config_t, x_pos_px, x_offset);
+    xram0_struct_set(status_struct, vga_mode1_config_t, y_pos_px, y_offset);
+    xram0_struct_set(status_struct, vga_mode1_config_t, width_chars, canvas_c);
+    xram0_struct_set(status_struct, vga_mode1_config_t, height_chars, 1);
+    xram0_struct_set(status_struct, vga_mode1_config_t, xram_data_ptr, canvas_data + 2*canvas_c*STATUS_DATA_ROW);
+    xram0_struct_set(status_struct, vga_mode1_config_t, xram_palette_ptr, 0xFFFF);
+    xram0_struct_set(status_struct, vga_mode1_config_t, xram_font_ptr, 0xFFFF);
+
+    xregn(1, 0, 1, 6, 1, font_bpp_opt, canvas_struct, plane, 0, text_top);
+    SplitTextRows(0); // text rows ring
+    xregn(1, 0, 1, 6, 1, font_bpp_opt, status_struct, plane, status_top, canvas_h);
+}
+
+// ---------------------------------------------------------------------------
+// canvas_type = 3 (640x480), font_opt = 1 (8x16), bpp_opt = 2 (4bpp),
+// plane = 0, canvas_struct = 0xFF00, canvas_data = 0x000
+// Plane 0 is split by scanlines into the menu row, the text rows and the
+// status bar row, each with its own config, so the text rows can scroll.
+// ---------------------------------------------------------------------------
+void InitDisplay(void)
+{
+    // initialize the canvas
+    xregn(1, 0, 0, 1, canvas_type);
+    SetRows();
+    ClearDisplay(bg_clr, fg_clr);
+}
 
+// ---------------------------------------------------------------------------
+// Switches between the 8x16 font, 30 rows, and the 8x8 font, 60 rows, which
+// needs 80x62 cells of canvas_data, with the rings' margins. The display is cleared, so whatever
+// was on it has to be drawn again, at the new rows.
+// ---------------------------------------------------------------------------
+void SetDenseText(bool dense)
+{
+    font_h = dense ? 8 : 16;
+    font_bpp_opt = dense ? 2 : 10; // 4bpp, plus 8 for the 8x16 font
+    canvas_r = canvas_h / font_h;
+    SetRows();
     ClearDisplay(bg_clr, fg_clr);
 }
 
+// ----------------------------------------------------------------------------
+// Returns the XRAM address of the cell at display row, col. Rows between
+// the menu and status bar rows are looked up in their text rows ring.
+// ----------------------------------------------------------------------------
+static uint16_t CellAddress(uint8_t row, uint8_t col)
+{
+    if (overlay_h > 0 && !beneath &&
+        row >= overlay_r && row < overlay_r + overlay_h &&
+        col >= overlay_c && col < overlay_c + overlay_w) {
+        return overlay_addr + 2*((row-overlay_r)*overlay_w + col-overlay_c);
+    }
+    if (row > 0 && row < canvas_r-1) {
+        uint8_t i = (ring_h[1] > 0 && row >= ring_row[1]) ? 1 : 0;
+        row = row - ring_row[i] + ring_top[i];
+        if (row > ring_h[i]) {
+            row -= ring_h[i]+1;
+        }
+        row += ring_data[i];
+    } else if (row == canvas_r-1) {
+        row = STATUS_DATA_ROW;
+    }
+    // for 4-bit color, index 2 bytes per ch
+    return canvas_data + 2*(row*canvas_c + col);
+}
+
+// ----------------------------------------------------------------------------
+// Splits the text rows into two rings, the first h0 rows high, or makes
+// them one ring if h0 is 0. Both rings are unscrolled, so all their rows
+// need to be redrawn.
+// ----------------------------------------------------------------------------
+void SplitTextRows(uint8_t h0)
+{
+    uint8_t h = canvas_r-2;
+    if (h0 == 0 || h0 >= h) {
+        ring_h[1] = 0;
+        SetRing(0, 1, 1, h);
+    } else {
+        SetRing(0, 1, 1, h0);
+        SetRing(1, 1+h0, 2+h0, h-h0);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Scrolls the text rows of ring up n rows (down, if n is negative) by moving
+// its y_pos_px. Only the rows scrolled into view need to be redrawn.
+// ----------------------------------------------------------------------------
+void ScrollTextRows(uint8_t ring, int8_t n)
+{
+    int8_t h = ring_h[ring]+1; // with its margin
+    int8_t top = (int8_t)ring_top[ring] + n % h;
+    if (top < 0) {
+        top += h;
+    } else if (top >= h) {
+        top -= h;
+    }
+    ring_top[ring] = top;
+    xram0_struct_set(text_struct[ring], vga_mode1_config_t, y_pos_px, -(int16_t)font_h*top);
+}
+
+// ----------------------------------------------------------------------------
+// Shows the text rows of ring px pixels lower than they are (higher, if
+// negative), so part of its margin row shows at the top (bottom). Stepping
+// px to 0 over a few frames scrolls a row in smoothly.
+// ----------------------------------------------------------------------------
+void NudgeTextRows(uint8_t ring, int8_t px)
+{
+    xram0_struct_set(text_struct[ring], vga_mode1_config_t, y_pos_px, -(int16_t)font_h*ring_top[ring] + px);
+}
+
 // ----------------------------------------------------------------------------
 // Changes TxDisplay bg_clr and fg_clr, then overwrites display using them.
 // Doesn't clear top or bottom rows, as these are for menu and status bar.
 // ----------------------------------------------------------------------------
 void ClearDisplay(uint8_t bg, uint8_t fg)
 {
-    uint8_t r, c;
+    uint8_t r;
 
     bg_clr = bg;
     fg_clr = fg;
 
-    RIA.addr0 = canvas_data;
-    RIA.step0 = 1;
-
     for (r = 0; r < canvas_r; r++) {
-        for (c = 0; c < canvas_c; c++) {
-            DrawChar(r, c, ' ', bg, fg);
-        }
+        FillSpan(r, 0, ' ', canvas_c, bg, fg);
     }
 }
 
@@ -77,21 +237,63 @@ void ClearDisplay(uint8_t bg, uint8_t fg)
 // ----------------------------------------------------------------------------
 void DrawChar(uint8_t row, uint8_t col, char ch, uint8_t bg, uint8_t fg)
 {
-    // for 4-bit color, index 2 bytes per ch
-    RIA.addr0 = canvas_data + 2*(row*canvas_c + col);
+    RIA.addr0 = CellAddress(row, col);
     RIA.step0 = 1;
     RIA.rw0 = ch;
     RIA.rw0 = (bg<<4) | fg;
 }
 
+// ----------------------------------------------------------------------------
+// Draws len chars from the cells at row, col rightwards. The address is set
+// once, then the char and color bytes are streamed.
+// NOTE: the span must not run past the end of the row
+// ----------------------------------------------------------------------------
+void DrawSpan(uint8_t row, uint8_t col, const char * chars, uint8_t len, uint8_t bg, uint8_t fg)
+{
+    uint8_t bgfg = (bg<<4) | fg;
+    RIA.addr0 = CellAddress(row, col);
+    RIA.step0 = 1;
+    while (len-- > 0) {
+        RIA.rw0 = *(chars++);
+        RIA.rw0 = bgfg;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Like DrawSpan, but each char has its own foreground color, from fgs
+// ----------------------------------------------------------------------------
+void DrawColoredSpan(uint8_t row, uint8_t col, const char * chars, const uint8_t * fgs, uint8_t len, uint8_t bg)
+{
+    bg <<= 4;
+    RIA.addr0 = CellAddress(row, col);
+    RIA.step0 = 1;
+    while (len-- > 0) {
+        RIA.rw0 = *(chars++);
+        RIA.rw0 = bg | *(fgs++);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Like DrawSpan, but draws ch in all len cells
+// ----------------------------------------------------------------------------
+void FillSpan(uint8_t row, uint8_t col, char ch, uint8_t len, uint8_t bg, uint8_t fg)
+{
+    uint8_t bgfg = (bg<<4) | fg;
+    RIA.addr0 = CellAddress(row, col);
+    RIA.step0 = 1;
+    while (len-- > 0) {
+        RIA.rw0 = ch;
+        RIA.rw0 = bgfg;
+    }
+}
+
 // ---------------------------------------------------------------------------
 // ---------------------------------------------------------------------------
 void GetChar(uint8_t row, uint8_t col, char * pch, uint8_t * pbg, uint8_t *pfg)
 {
      uint8_t bgfg;
 
-    // for 4-bit color, index 2 bytes per ch
-    RIA.addr0 = canvas_data + 2*(row*canvas_c + col);
+    RIA.addr0 = CellAddress(row, col);
     RIA.step0 = 1;
     *pch = RIA.rw0;
     bgfg = RIA.rw0;
@@ -100,45 +302,72 @@ void GetChar(uint8_t row, uint8_t col, char * pch, uint8_t * pbg, uint8_t *pfg)
 }
 
 // ---------------------------------------------------------------------------
+// Has the cells in the w by h rectangle at display row, col drawn on the
+// overlay canvas at data, w*h*2 bytes, without showing it yet
 // ---------------------------------------------------------------------------
-bool BackupChars(uint8_t row, uint8_t col, uint8_t width, uint8_t height, uint8_t * pstash)
+void SetOverlay(uint16_t data, uint8_t row, uint8_t col, uint8_t w, uint8_t h)
 {
-    if (pstash != NULL) {
-        uint8_t * pbyte = pstash;
-        uint16_t r, c;
-        for (r = row; r < row + height; r++) {
-            for (c = col; c < col + width; c++) {
-                // for 4-bit color, index 2 bytes per ch
-                RIA.addr0 = canvas_data + 2*(r*canvas_c + c);
-                RIA.step0 = 1;
-                *(pbyte++) = RIA.rw0; // ch
-                *(pbyte++) = RIA.rw0; // bgfg
-            }
-        }
-        return true; // backup succeeded
-    }
-    return false;
+    overlay_addr = data;
+    overlay_r = row;
+    overlay_c = col;
+    overlay_w = w;
+    overlay_h = h;
 }
 
 // ---------------------------------------------------------------------------
+// Shows the overlay set by SetOverlay, by programming plane 1 with its canvas
 // ---------------------------------------------------------------------------
-bool RestoreChars(uint8_t row, uint8_t col, uint8_t width, uint8_t height, uint8_t * pstash)
+void ShowOverlay(void)
 {
-    if (pstash != NULL) {
-        uint8_t * pbyte = pstash;
-        uint16_t r, c;
-        for (r = row; r < row + height; r++) {
-            for (c = col; c < col + width; c++) {
-                // for 4-bit color, index 2 bytes per ch
-                RIA.addr0 = canvas_data + 2*(r*canvas_c + c);
-                RIA.step0 = 1;
-                RIA.rw0 = *(pbyte++); // ch
-                RIA.rw0 = *(pbyte++); // bgfg
-            }
-        }
-        return true; // restore suceeded
+    xram0_struct_set(overlay_struct, vga_mode1_config_t, x_wrap, false);
+    xram0_struct_set(overlay_struct, vga_mode1_config_t, y_wrap, false);
+    xram0_struct_set(overlay_struct, vga_mode1_config_t, x_pos_px, font_w*overlay_c);
+    xram0_struct_set(overlay_struct, vga_mode1_config_t, y_pos_px, font_h*overlay_r);
+    xram0_struct_set(overlay_struct, vga_mode1_config_t, width_chars, overlay_w);
+    xram0_struct_set(overlay_struct, vga_mode1_config_t, height_chars, overlay_h);
+    xram0_struct_set(overlay_struct, vga_mode1_config_t, xram_data_ptr, overlay_addr);
+    xram0_struct_set(overlay_struct, vga_mode1_config_t, xram_palette_ptr, 0xFFFF);
+    xram0_struct_set(overlay_struct, vga_mode1_config_t, xram_font_ptr, 0xFFFF);
+    xregn(1, 0, 1, 6, 1, font_bpp_opt, overlay_struct, overlay_plane, 0, canvas_h);
+}
+
+// ---------------------------------------------------------------------------
+// Opens an overlay, w by h cells at display row, col, on overlay_data.
+// Fails if it won't fit in OVERLAY_SIZE. The cells aren't cleared, so the
+// popup has to draw all of them.
+// ---------------------------------------------------------------------------
+bool OpenOverlay(uint8_t row, uint8_t col, uint8_t w, uint8_t h)
+{
+    if (w == 0 || h == 0 || (uint16_t)w*h*2 > OVERLAY_SIZE) {
+        return false;
     }
-    return false;
+    SetOverlay(overlay_data, row, col, w, h);
+    ShowOverlay();
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Closes the overlay, so drawing goes to plane 0 again. Plane 1 is left
+// for the caller to reprogram.
+// ---------------------------------------------------------------------------
+void CloseOverlay(void)
+{
+    overlay_h = 0;
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+bool OverlayOpen(void)
+{
+    return overlay_h > 0;
+}
+
+// ---------------------------------------------------------------------------
+// Has drawing go to plane 0 even under the overlay, as text updates do
+// ---------------------------------------------------------------------------
+void DrawBeneathOverlay(bool b)
+{
+    beneath = b;
 }
 
 // ---------------------------------------------------------------------------
@@ -9,14 +9,28 @@
 #include <stdint.h>
 #include "colors.h"
 
+#define NUM_RINGS 2 // independently scrolling bands of text rows
+#define OVERLAY_SIZE 0x300 // bytes of popup overlay cells, 2 per cell
+
 typedef enum {NO_POPUP_TYPE, MSGDIALOG, FILEDIALOG, SUBMENU, CONTEXTMENU} popup_type_t;
 
 void InitDisplay(void);
 void ClearDisplay(uint8_t display_bg, uint8_t display_fg);
+void SetDenseText(bool dense);
+void SplitTextRows(uint8_t h0);
+void ScrollTextRows(uint8_t ring, int8_t n);
+void NudgeTextRows(uint8_t ring, int8_t px);
 void DrawChar(uint8_t row, uint8_t col, char ch, uint8_t bg, uint8_t fg);
+void DrawSpan(uint8_t row, uint8_t col, const char * chars, uint8_t len, uint8_t bg, uint8_t fg);
+void DrawColoredSpan(uint8_t row, uint8_t col, const char * chars, const uint8_t * fgs, uint8_t len, uint8_t bg);
+void FillSpan(uint8_t row, uint8_t col, char ch, uint8_t len, uint8_t bg, uint8_t fg);
 void GetChar(uint8_t row, uint8_t col, char * pch, uint8_t *pbg, uint8_t * pfg);
-bool BackupChars(uint8_t row, uint8_t col, uint8_t width, uint8_t height, uint8_t * pstash);
-bool RestoreChars(uint8_t row, uint8_t col, uint8_t width, uint8_t height, uint8_t * pstash);
+void SetOverlay(uint16_t data, uint8_t row, uint8_t col, uint8_t w, uint8_t h);
+void ShowOverlay(void);
+bool OpenOverlay(uint8_t row, uint8_t col, uint8_t w, uint8_t h);
+void CloseOverlay(void);
+bool OverlayOpen(void);
+void DrawBeneathOverlay(bool b);
 
 uint16_t canvas_struct_address(void);
 uint16_t canvas_data_address(void);
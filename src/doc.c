@@ -9,7 +9,9 @@
 #include <string.h>
 #include "doc.h"
 
-// for the main window's document textbox, starting at 0x1130
+#define is_blank(ch) ((ch) == ' ' || (ch) == '\t' || (ch) == '\n' || (ch) == 0)
+
+// for the main window's document textbox, starting at 0x2700
 static doc_row_t doc_rows[DOC_ROWS]; // array of pointers to extended memory
 
 doc_t TheDoc = {
@@ -17,10 +19,19 @@ doc_t TheDoc = {
     0, // cur_filename_c
     0, // cursor_r
     0, // cursor_c
-    0, // offset_r
     0, // last_row
+    0, // num_chars
+    0, // num_words
     false, // dirty
+    false, // auto_indent
     {0}, //filename
+    {NO_BOOKMARK, NO_BOOKMARK, NO_BOOKMARK,
+     NO_BOOKMARK, NO_BOOKMARK, NO_BOOKMARK,
+     NO_BOOKMARK, NO_BOOKMARK, NO_BOOKMARK}, // bookmarks
+    NO_LEX_ROW, // lex_from
+    0, // lex_to
+    0, // num_folds
+    {{0, 0}}, // folds
     doc_rows
 }; // the one and only
 
@@ -34,16 +45,22 @@ void ClearDoc(bool save_filename)
     TheDoc.cur_filename_c = 0;
     TheDoc.cursor_r = 0;
     TheDoc.cursor_c = 0;
-    TheDoc.offset_r = 0;
     TheDoc.last_row = 0;
+    TheDoc.num_chars = 0;
+    TheDoc.num_words = 0;
     TheDoc.dirty = false;
     if (!save_filename) {
         memset(TheDoc.filename, 0, MAX_FILENAME+1);
     }
+    ClearBookmarks();
+    ClearFolds();
+    TheDoc.lex_from = NO_LEX_ROW;
+    TheDoc.lex_to = 0;
     TheDoc.rows = doc_rows;
     for (r = 0 ; r < DOC_ROWS; r++) {
         TheDoc.rows[r].ptxt = (void*)(DOC_MEM_START + sizeof(uint8_t)*(DOC_COLS*(r+1)));
         TheDoc.rows[r].len = 0;
+        TheDoc.rows[r].lex = 0;
         RIA.addr0 = (uint16_t)TheDoc.rows[r].ptxt;
         RIA.step0 = 1;
         for (c = 0; c < DOC_COLS; c++) {
@@ -52,6 +69,297 @@ void ClearDoc(bool save_filename)
     }
 }
 
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void ClearBookmarks(void)
+{
+    uint8_t i;
+    for (i = 0; i < NUM_BOOKMARKS; i++) {
+        TheDoc.bookmarks[i] = NO_BOOKMARK;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void ClearFolds(void)
+{
+    TheDoc.num_folds = 0;
+}
+
+// ---------------------------------------------------------------------------
+// Folds rows first+1 to last under row first. Folds inside the new one are
+// merged into it, but it's refused if it overlaps only part of another one,
+// or if there's no room for it.
+// ---------------------------------------------------------------------------
+bool AddFold(uint16_t first, uint16_t last)
+{
+    uint8_t i, n = 0;
+    if (first >= last || last > TheDoc.last_row) {
+        return false;
+    }
+    for (i = 0; i < TheDoc.num_folds; i++) {
+        doc_fold_t * f = &TheDoc.folds[i];
+        bool inside = f->first >= first && f->last <= last;
+        if (!inside && f->first <= last && f->last >= first) {
+            return false;
+        }
+        n += inside ? 0 : 1;
+    }
+    if (n == MAX_FOLDS) {
+        return false;
+    }
+    for (i = n = 0; i < TheDoc.num_folds; i++) {
+        doc_fold_t * f = &TheDoc.folds[i];
+        if (f->first < first || f->last > last) {
+            TheDoc.folds[n++] = *f;
+        }
+    }
+    for (i = n; i > 0 && TheDoc.folds[i-1].first > first; i--) {
+        TheDoc.folds[i] = TheDoc.folds[i-1];
+    }
+    TheDoc.folds[i].first = first;
+    TheDoc.folds[i].last = last;
+    TheDoc.num_folds = n+1;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Unfolds the fold shown as row first, if there is one
+// ---------------------------------------------------------------------------
+bool RemoveFold(uint16_t first)
+{
+    uint8_t i;
+    for (i = 0; i < TheDoc.num_folds; i++) {
+        if (TheDoc.folds[i].first == first) {
+            TheDoc.num_folds--;
+            memmove(&TheDoc.folds[i], &TheDoc.folds[i+1],
+                    (TheDoc.num_folds - i) * sizeof(doc_fold_t));
+            return true;
+        }
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Unfolds any folds with rows in first to last, before rows there change
+// ---------------------------------------------------------------------------
+static void UnfoldRows(uint16_t first, uint16_t last)
+{
+    uint8_t i, n = 0;
+    for (i = 0; i < TheDoc.num_folds; i++) {
+        doc_fold_t * f = &TheDoc.folds[i];
+        if (f->first > last || f->last < first) {
+            TheDoc.folds[n++] = *f;
+        }
+    }
+    TheDoc.num_folds = n;
+}
+
+// ---------------------------------------------------------------------------
+// Returns the leading blanks of a row, or len if it's blank
+// ---------------------------------------------------------------------------
+static uint8_t RowIndent(const char * row, uint8_t len)
+{
+    uint8_t c = 0;
+    while (c < len && is_blank(row[c])) {
+        c++;
+    }
+    return c;
+}
+
+// ---------------------------------------------------------------------------
+// Returns true if row R is empty or only blanks, so it separates paragraphs
+// ---------------------------------------------------------------------------
+bool BlankRow(uint16_t R)
+{
+    char row[DOC_COLS];
+    uint8_t len = TheDoc.rows[R].len;
+    ReadStr(TheDoc.rows[R].ptxt, row, len);
+    return RowIndent(row, len) == len;
+}
+
+// ---------------------------------------------------------------------------
+// Returns the braces a row opens, less those it closes
+// ---------------------------------------------------------------------------
+static int8_t RowBraces(const char * row, uint8_t len)
+{
+    int8_t depth = 0;
+    uint8_t c;
+    for (c = 0; c < len; c++) {
+        depth += (row[c] == '{') - (row[c] == '}');
+    }
+    return depth;
+}
+
+// ---------------------------------------------------------------------------
+// Finds the last row a fold shown as row R would hide. If R opens a brace,
+// that's the row closing it, else the last of the rows below R indented
+// deeper than it, such as the code under an asm label. Blank rows inside
+// the block go with it. Returns false if there's nothing to fold.
+// ---------------------------------------------------------------------------
+bool FindFoldRange(uint16_t R, uint16_t * plast)
+{
+    char row[DOC_COLS];
+    uint8_t len = TheDoc.rows[R].len;
+    uint8_t indent;
+    int16_t depth;
+    uint16_t k, last = R;
+    ReadStr(TheDoc.rows[R].ptxt, row, len);
+    indent = RowIndent(row, len);
+    depth = RowBraces(row, len);
+    for (k = R+1; k <= TheDoc.last_row; k++) {
+        len = TheDoc.rows[k].len;
+        ReadStr(TheDoc.rows[k].ptxt, row, len);
+        if (depth > 0) {
+            last = k;
+            depth += RowBraces(row, len);
+            if (depth <= 0) {
+                break;
+            }
+        } else if (RowIndent(row, len) < len) {
+            if (RowIndent(row, len) <= indent) {
+                break;
+            }
+            last = k;
+        }
+    }
+    *plast = last;
+    return last > R;
+}
+
+// ---------------------------------------------------------------------------
+// Returns the last row shown as row R: the fold's last row if R is shown
+// for a fold, else R. Like the rest of the fold index lookups, this is a
+// pass over the folds, not the rows they hide.
+// ---------------------------------------------------------------------------
+uint16_t FoldEnd(uint16_t R)
+{
+    uint8_t i;
+    for (i = 0; i < TheDoc.num_folds && TheDoc.folds[i].first <= R; i++) {
+        if (TheDoc.folds[i].first == R) {
+            return TheDoc.folds[i].last;
+        }
+    }
+    return R;
+}
+
+// ---------------------------------------------------------------------------
+// Returns the row row R is shown as: the fold's first row if R is hidden in
+// a fold, else R
+// ---------------------------------------------------------------------------
+uint16_t FoldStart(uint16_t R)
+{
+    uint8_t i;
+    for (i = 0; i < TheDoc.num_folds && TheDoc.folds[i].first < R; i++) {
+        if (TheDoc.folds[i].last >= R) {
+            return TheDoc.folds[i].first;
+        }
+    }
+    return R;
+}
+
+// ---------------------------------------------------------------------------
+// Returns the row n shown rows below (or above, if n < 0) row R, stopping
+// at the first or last row. A fold counts as one row.
+// ---------------------------------------------------------------------------
+uint16_t StepShownRows(uint16_t R, int16_t n)
+{
+    for (; n > 0 && FoldEnd(R) < TheDoc.last_row; n--) {
+        R = FoldEnd(R) + 1;
+    }
+    for (; n < 0 && R > 0; n++) {
+        R = FoldStart(R-1);
+    }
+    return R;
+}
+
+// ---------------------------------------------------------------------------
+// Notes that the text of rows first to last changed, so the syntax lexer
+// re-lexes them (and on, until its row end states converge)
+// ---------------------------------------------------------------------------
+void LexRowsChanged(uint16_t first, uint16_t last)
+{
+    if (first < TheDoc.lex_from) {
+        TheDoc.lex_from = first;
+    }
+    if (last > TheDoc.lex_to) {
+        TheDoc.lex_to = last;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Shifts the bookmarks, folds and re-lex range ends on rows first to last by
+// delta rows, so they keep pointing at the same text when rows are added or
+// deleted. Folds across first were unfolded, so they shift whole.
+// ---------------------------------------------------------------------------
+static void ShiftRowRefs(uint16_t first, uint16_t last, int16_t delta)
+{
+    uint8_t i;
+    for (i = 0; i < TheDoc.num_folds; i++) {
+        if (TheDoc.folds[i].first >= first && TheDoc.folds[i].first <= last) {
+            TheDoc.folds[i].first += delta;
+            TheDoc.folds[i].last += delta;
+        }
+    }
+    for (i = 0; i < NUM_BOOKMARKS; i++) {
+        uint16_t R = TheDoc.bookmarks[i];
+        if (R != NO_BOOKMARK && R >= first && R <= last) {
+            TheDoc.bookmarks[i] = R + delta;
+        }
+    }
+    if (TheDoc.lex_from != NO_LEX_ROW && TheDoc.lex_from >= first && TheDoc.lex_from <= last) {
+        TheDoc.lex_from += delta;
+    }
+    if (TheDoc.lex_to >= first && TheDoc.lex_to <= last) {
+        TheDoc.lex_to += delta;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Counts the words (runs of non-blank chars) in str
+// ---------------------------------------------------------------------------
+uint8_t CountWords(const char * str, uint8_t len)
+{
+    uint8_t c, words = 0;
+    bool in_word = false;
+    for (c = 0; c < len; c++) {
+        if (is_blank(str[c])) {
+            in_word = false;
+        } else if (!in_word) {
+            in_word = true;
+            words++;
+        }
+    }
+    return words;
+}
+
+// ---------------------------------------------------------------------------
+// Adds (or removes) a row's chars and words to (or from) the doc statistics
+// ---------------------------------------------------------------------------
+void CountRowStats(const char * str, uint8_t len, bool add)
+{
+    uint8_t words = CountWords(str, len);
+    if (add) {
+        TheDoc.num_chars += len;
+        TheDoc.num_words += words;
+    } else {
+        TheDoc.num_chars -= len;
+        TheDoc.num_words -= words;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Change in word count from putting mid between left and right, which
+// is the negative of the change from removing it from between them
+// ---------------------------------------------------------------------------
+static int8_t WordDelta(char left, char mid, char right)
+{
+    if (is_blank(mid)) { // splits a word?
+        return (!is_blank(left) && !is_blank(right)) ? 1 : 0;
+    } // else starts a new word?
+    return (is_blank(left) && is_blank(right)) ? 1 : 0;
+}
+
 // ---------------------------------------------------------------------------
 // copy extended mem row to local working buffer
 // ---------------------------------------------------------------------------
@@ -105,7 +413,11 @@ bool AddChar(char chr)
             }
             row[TheDoc.cursor_c++] = chr; //OK, now insert new char
             row[++TheDoc.rows[cur_r].len] = '\n'; // just making sure
+            TheDoc.num_chars++;
+            TheDoc.num_words += WordDelta((TheDoc.cursor_c > 1) ? row[TheDoc.cursor_c-2] : 0,
+                                          chr, row[TheDoc.cursor_c]);
             WriteStr(TheDoc.rows[cur_r].ptxt, row, DOC_COLS);
+            LexRowsChanged(cur_r, cur_r);
             if (TheDoc.last_row < cur_r) {
                 TheDoc.last_row = cur_r;
             }
@@ -129,10 +441,14 @@ bool DeleteChar(bool backspace)
         ReadStr(TheDoc.rows[cur_r].ptxt, row, TheDoc.rows[cur_r].len); // no '\n'
         if (backspace) { // delete char to left of cursor (if one), then ...
             if (TheDoc.cursor_c > 0) { // ... just shift remaining text left
+                TheDoc.num_chars--;
+                TheDoc.num_words -= WordDelta((cur_c > 1) ? row[cur_c-2] : 0,
+                                              row[cur_c-1], row[cur_c]);
                 memmove(row + cur_c-1, row + cur_c, DOC_COLS - cur_c-1);
                 TheDoc.cursor_c--;
                 TheDoc.rows[cur_r].len--;
                 WriteStr(TheDoc.rows[TheDoc.cursor_r].ptxt, row, DOC_COLS);
+                LexRowsChanged(cur_r, cur_r);
                 TheDoc.dirty = true;
                 retval = true;
             } else { // ... at row start, so append current row to row above and delete current row
@@ -141,16 +457,17 @@ bool DeleteChar(bool backspace)
                     retval = DeleteRow(cur_r);
                     TheDoc.cursor_r = cur_r-1;
                     TheDoc.cursor_c = target_row_len;
-                    if (TheDoc.cursor_r < TheDoc.offset_r) {
-                        TheDoc.offset_r = TheDoc.cursor_r;
-                    }
                 }
             }
         } else { // delete char at cursor (if one), then ...
             if (TheDoc.cursor_c < TheDoc.rows[cur_r].len) { // ... just shift remaining text left
+                TheDoc.num_chars--;
+                TheDoc.num_words -= WordDelta((cur_c > 0) ? row[cur_c-1] : 0,
+                                              row[cur_c], row[cur_c+1]);
                 memmove(row + cur_c, row + cur_c+1, DOC_COLS - cur_c);
                 TheDoc.rows[cur_r].len--;
                 WriteStr(TheDoc.rows[TheDoc.cursor_r].ptxt, row, DOC_COLS);
+                LexRowsChanged(cur_r, cur_r);
                 TheDoc.dirty = true;
                 retval = true;
             } else { // ... at row end, so append row below to current row, and delete row below
@@ -173,15 +490,35 @@ bool AddNewLine(void)
     if (AddRow(TheDoc.cursor_r)) {
         uint16_t cur_r = TheDoc.cursor_r;
         uint16_t cur_c = TheDoc.cursor_c;
+        uint8_t tail_len = TheDoc.rows[cur_r].len - cur_c;
+        uint8_t indent = 0;
         // Move the relavent part of the current row to the new row:
         // copy current row from extended ram
         memset(row, 0, DOC_COLS);
         ReadStr(TheDoc.rows[cur_r].ptxt, row, TheDoc.rows[cur_r].len+1);
 
+        // AddRow counted the row twice, but the split halves replace both copies
+        CountRowStats(row, TheDoc.rows[cur_r].len, false);
+        CountRowStats(row, TheDoc.rows[cur_r].len, false);
+
+        // if auto-indenting, the new line starts with the current line's
+        // leading whitespace, so it all goes out in the same row write
+        if (TheDoc.auto_indent) {
+            while (indent < cur_c && (row[indent] == ' ' || row[indent] == '\t')) {
+                indent++;
+            }
+            if (indent + tail_len >= DOC_COLS) {
+                indent = DOC_COLS-1 - tail_len;
+            }
+            memcpy(new_row, row, indent);
+        }
+
         // copy the text after the cursor to the new line
-        memcpy(new_row, row + cur_c, TheDoc.rows[cur_r].len - cur_c + 1);
+        memcpy(new_row + indent, row + cur_c, tail_len + 1);
         WriteStr(TheDoc.rows[cur_r+1].ptxt, new_row, DOC_COLS);
-        TheDoc.rows[cur_r+1].len = TheDoc.rows[cur_r].len - cur_c;
+        TheDoc.rows[cur_r+1].len = indent + tail_len;
+        CountRowStats(new_row, TheDoc.rows[cur_r+1].len, true);
+        CountRowStats(row, cur_c, true);
 
         // clear the text after the cursor on the current line
         memset(row + cur_c, 0, DOC_COLS - cur_c);
@@ -189,19 +526,46 @@ bool AddNewLine(void)
 
         WriteStr(TheDoc.rows[cur_r].ptxt, row, DOC_COLS);
         TheDoc.rows[cur_r].len = cur_c;
+        LexRowsChanged(cur_r, cur_r+1);
 
-        // finally, position the cursor at the beginning of the new line
+        // finally, position the cursor at the start of the new line's text
         TheDoc.cursor_r++;
-        TheDoc.cursor_c = 0;
-        if (TheDoc.cursor_r >= TheDoc.offset_r + DOC_ROWS_DISPLAYED) {
-            TheDoc.offset_r++;
-        }
+        TheDoc.cursor_c = indent;
         TheDoc.dirty = true;
         return true;
     }
     return false;
 }
 
+// ---------------------------------------------------------------------------
+// Reverses the order of the row entries from first up to (not including) last.
+// Only the row table changes, the row text stays put in extended mem.
+// ---------------------------------------------------------------------------
+static void ReverseRows(uint16_t first, uint16_t last)
+{
+    doc_row_t tmp;
+    while (first + 1 < last) {
+        last--;
+        tmp = TheDoc.rows[first];
+        TheDoc.rows[first] = TheDoc.rows[last];
+        TheDoc.rows[last] = tmp;
+        first++;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Rotates the row entries from first up to (not including) last,
+// so that the entry at middle ends up at first.
+// ---------------------------------------------------------------------------
+static void RotateRows(uint16_t first, uint16_t middle, uint16_t last)
+{
+    if (first < middle && middle < last) {
+        ReverseRows(first, middle);
+        ReverseRows(middle, last);
+        ReverseRows(first, last);
+    }
+}
+
 // ---------------------------------------------------------------------------
 // Adds a row below row_index to doc, then
 // copies all row data (including row[row_index]) to next row.
@@ -209,17 +573,83 @@ bool AddNewLine(void)
 bool AddRow(uint16_t row_index)
 {
     if (row_index < DOC_ROWS-1) {
-        if (TheDoc.last_row+1 < DOC_ROWS) { // check if new row is OK
-            int16_t r;
+        return DuplicateRows(row_index, row_index);
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Deletes row[row_index] in doc, by shifting up data from rows below.
+// ---------------------------------------------------------------------------
+bool DeleteRow(uint16_t row_index)
+{
+    if (row_index < DOC_ROWS-1) {
+        return DeleteRows(row_index, row_index);
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Moves rows first to last up (or down) one row, by rotating the row above
+// (or below) them to the other end of the block. No row text is copied.
+// ---------------------------------------------------------------------------
+bool MoveRows(uint16_t first, uint16_t last, bool up)
+{
+    if (first <= last && last <= TheDoc.last_row) {
+        uint8_t i;
+        if (up && first > 0) {
+            RotateRows(first-1, first, last+1);
+        } else if (!up && last < TheDoc.last_row) {
+            RotateRows(first, last+1, last+2);
+        } else {
+            return false; // already at top or bottom of doc
+        }
+        LexRowsChanged(up ? first-1 : first, up ? last : last+1);
+        UnfoldRows(up ? first-1 : first, up ? last : last+1);
+        // bookmarks move with their rows
+        for (i = 0; i < NUM_BOOKMARKS; i++) {
+            uint16_t R = TheDoc.bookmarks[i];
+            if (R == NO_BOOKMARK) {
+                continue;
+            } else if (up) {
+                TheDoc.bookmarks[i] = (R == first-1) ? last :
+                                      (R >= first && R <= last) ? R-1 : R;
+            } else {
+                TheDoc.bookmarks[i] = (R == last+1) ? first :
+                                      (R >= first && R <= last) ? R+1 : R;
+            }
+        }
+        TheDoc.dirty = true;
+        return true;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Inserts a copy of rows first to last just below them. The unused row
+// entries past the last row are rotated into place, so the only row text
+// copied is that of the duplicated rows.
+// ---------------------------------------------------------------------------
+bool DuplicateRows(uint16_t first, uint16_t last)
+{
+    if (first <= last && last <= TheDoc.last_row) {
+        uint16_t n = last - first + 1;
+        if (TheDoc.last_row + n < DOC_ROWS) { // check if new rows are OK
+            uint16_t r;
             char row[DOC_COLS] = {0};
-            // move all rows below current row down 1
-            for (r = (int16_t)TheDoc.last_row; r >= (int16_t)row_index; r--) {
+            UnfoldRows(last, last); // the new rows can't go inside a fold
+            // move n unused entries from past the last row to below the block
+            RotateRows(last+1, TheDoc.last_row+1, TheDoc.last_row+1+n);
+            for (r = first; r <= last; r++) {
                 memset(row, 0, DOC_COLS);
                 ReadStr(TheDoc.rows[r].ptxt, row, TheDoc.rows[r].len+1);
-                WriteStr(TheDoc.rows[r+1].ptxt, row, DOC_COLS);
-                TheDoc.rows[r+1].len = TheDoc.rows[r].len;
+                WriteStr(TheDoc.rows[r+n].ptxt, row, DOC_COLS);
+                TheDoc.rows[r+n].len = TheDoc.rows[r].len;
+                CountRowStats(row, TheDoc.rows[r].len, true);
             }
-            TheDoc.last_row++;
+            ShiftRowRefs(last+1, TheDoc.last_row, n);
+            LexRowsChanged(last+1, last+n);
+            TheDoc.last_row += n;
             TheDoc.dirty = true;
             return true;
         }
@@ -228,31 +658,234 @@ bool AddRow(uint16_t row_index)
 }
 
 // ---------------------------------------------------------------------------
-// Deletes row[row_index] in doc, by shifting up data from rows below.
+// Deletes rows first to last, by rotating their entries past the last row
+// and clearing them. If every row is deleted, an empty row 0 remains.
 // ---------------------------------------------------------------------------
-bool DeleteRow(uint16_t row_index)
+bool DeleteRows(uint16_t first, uint16_t last)
 {
-    if (row_index < DOC_ROWS-1 && row_index <= TheDoc.last_row)  {
-        int16_t r;
+    if (first <= last && last <= TheDoc.last_row) {
+        uint16_t n = last - first + 1;
+        uint16_t r;
+        uint8_t i;
         char row[DOC_COLS] = {0};
-        // move all rows below current row up 1
-        for (r = (int16_t)row_index; r <= (int16_t)TheDoc.last_row; r++) {
+        // bookmarks on deleted rows move to the row above, as that is
+        // where a joined row's text ends up
+        for (i = 0; i < NUM_BOOKMARKS; i++) {
+            uint16_t R = TheDoc.bookmarks[i];
+            if (R != NO_BOOKMARK && R >= first && R <= last) {
+                TheDoc.bookmarks[i] = (first > 0) ? first-1 : 0;
+            }
+        }
+        // and a fold ending there is unfolded, so that text isn't hidden
+        UnfoldRows((first > 0) ? first-1 : 0, last);
+        ShiftRowRefs(last+1, TheDoc.last_row, -(int16_t)n);
+        // move deleted entries past the remaining rows
+        RotateRows(first, last+1, TheDoc.last_row+1);
+        // clear the now unused rows
+        for (r = TheDoc.last_row+1-n; r <= TheDoc.last_row; r++) {
+            ReadStr(TheDoc.rows[r].ptxt, row, TheDoc.rows[r].len);
+            CountRowStats(row, TheDoc.rows[r].len, false);
             memset(row, 0, DOC_COLS);
-            ReadStr(TheDoc.rows[r+1].ptxt, row, TheDoc.rows[r+1].len+1);
             WriteStr(TheDoc.rows[r].ptxt, row, DOC_COLS);
-            TheDoc.rows[r].len = TheDoc.rows[r+1].len;
+            TheDoc.rows[r].len = 0;
         }
-        // clear previous last row
-        memset(row, 0, DOC_COLS);
-        WriteStr(TheDoc.rows[TheDoc.last_row].ptxt, row, DOC_COLS);
-        TheDoc.rows[TheDoc.last_row].len = 0;
-        TheDoc.last_row--;
+        TheDoc.last_row = (TheDoc.last_row >= n) ? TheDoc.last_row - n : 0;
+        LexRowsChanged(first, first);
         TheDoc.dirty = true;
         return true;
     }
     return false;
 }
 
+// ---------------------------------------------------------------------------
+// Replaces rows first to last with the n new rows built past the last row.
+// Two rotations of the row table do the whole net shift at once, and the
+// replaced rows become unused rows past the new last row.
+// ---------------------------------------------------------------------------
+static void SpliceRows(uint16_t first, uint16_t last, uint16_t n)
+{
+    uint16_t n_src = last - first + 1;
+    uint16_t n_tail = TheDoc.last_row - last;
+    uint16_t mark = (n == 0 && first > 0) ? first-1 : first;
+    uint16_t r;
+    uint8_t i;
+    char row[DOC_COLS] = {0};
+    // [src][tail][new] -> [tail][new][src] -> [new][tail][src]
+    RotateRows(first, last+1, TheDoc.last_row+1+n);
+    RotateRows(first, first+n_tail, first+n_tail+n);
+    // clear the replaced rows, now unused
+    for (r = first+n+n_tail; r < first+n+n_tail+n_src; r++) {
+        WriteStr(TheDoc.rows[r].ptxt, row, DOC_COLS);
+        TheDoc.rows[r].len = 0;
+    }
+    // bookmarks on replaced rows move to the first new row, or the row
+    // above when there are none
+    for (i = 0; i < NUM_BOOKMARKS; i++) {
+        uint16_t R = TheDoc.bookmarks[i];
+        if (R != NO_BOOKMARK && R >= first && R <= last) {
+            TheDoc.bookmarks[i] = mark;
+        }
+    }
+    UnfoldRows(mark, last);
+    ShiftRowRefs(last+1, TheDoc.last_row, (int16_t)n - (int16_t)n_src);
+    TheDoc.last_row = TheDoc.last_row + n - n_src;
+    LexRowsChanged(mark, first+n);
+    TheDoc.dirty = true;
+}
+
+// ---------------------------------------------------------------------------
+// Writes str as the n'th new row past the last row, where ReflowRows
+// builds its rows until they are spliced in.
+// NOTE: str needs room for a trailing '\n'
+// ---------------------------------------------------------------------------
+static bool BuildRow(char * str, uint8_t len, uint16_t n)
+{
+    uint16_t r = TheDoc.last_row + 1 + n;
+    if (r < DOC_ROWS) {
+        str[len] = '\n';
+        WriteStr(TheDoc.rows[r].ptxt, str, len+1);
+        TheDoc.rows[r].len = len;
+        return true;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Joins rows first to last into row first, in one pass. Leading blanks of
+// the joined rows are dropped, and a single space separates them.
+// ---------------------------------------------------------------------------
+bool JoinRows(uint16_t first, uint16_t last)
+{
+    if (first < last && last <= TheDoc.last_row) {
+        char row[DOC_COLS];
+        char out[DOC_COLS] = {0};
+        uint8_t len = 0;
+        uint16_t chars_old = 0;
+        uint16_t R;
+        for (R = first; R <= last; R++) {
+            uint8_t c = 0;
+            uint8_t n = TheDoc.rows[R].len;
+            ReadStr(TheDoc.rows[R].ptxt, row, n);
+            chars_old += n;
+            if (R > first) {
+                while (c < n && is_blank(row[c])) {
+                    c++;
+                }
+                if (c < n) {
+                    while (len > 0 && is_blank(out[len-1])) {
+                        len--;
+                    }
+                    if (len > 0) {
+                        out[len++] = ' ';
+                    }
+                }
+            }
+            if (len + n - c >= DOC_COLS) {
+                return false; // result too long, and nothing has changed yet
+            }
+            memcpy(out + len, row + c, n - c);
+            len += n - c;
+        }
+        // the joined row is written once, then the rest are removed at once
+        out[len] = '\n';
+        WriteStr(TheDoc.rows[first].ptxt, out, len+1);
+        TheDoc.rows[first].len = len;
+        SpliceRows(first+1, last, 0);
+        TheDoc.num_chars += len - chars_old; // word count doesn't change
+        return true;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Reflows the paragraphs in rows first to last so no row is wider than
+// width (unless a single word is), keeping blank rows between paragraphs
+// and the indent of each paragraph's first row. The new rows are built
+// in one streaming pass past the last row, then spliced in at once.
+// ---------------------------------------------------------------------------
+bool ReflowRows(uint16_t first, uint16_t last, uint8_t width)
+{
+    if (first <= last && last <= TheDoc.last_row && width > 0 && width < DOC_COLS) {
+        char row[DOC_COLS];
+        char out[DOC_COLS] = {0};
+        uint8_t len = 0;
+        uint8_t indent = 0;
+        bool has_words = false;
+        bool new_par = true;
+        bool ok = true;
+        uint16_t n = 0;
+        uint16_t chars_old = 0;
+        uint16_t chars_new = 0;
+        uint16_t R;
+        for (R = first; R <= last && ok; R++) {
+            uint8_t c;
+            uint8_t w;
+            uint8_t n_r = TheDoc.rows[R].len;
+            ReadStr(TheDoc.rows[R].ptxt, row, n_r);
+            chars_old += n_r;
+            c = RowIndent(row, n_r);
+            if (c == n_r) { // blank row ends the paragraph, and is kept
+                if (has_words) {
+                    ok = BuildRow(out, len, n++);
+                    chars_new += len;
+                }
+                ok = ok && BuildRow(out, 0, n++);
+                len = 0;
+                has_words = false;
+                new_par = true;
+                continue;
+            }
+            if (new_par) {
+                indent = (c < width/2) ? c : width/2;
+                memcpy(out, row, indent);
+                len = indent;
+                new_par = false;
+            }
+            while (c < n_r && ok) {
+                while (c < n_r && is_blank(row[c])) {
+                    c++;
+                }
+                if (c == n_r) {
+                    break;
+                }
+                for (w = c; w < n_r && !is_blank(row[w]); w++) {
+                    ;
+                }
+                if (has_words && len + 1 + (w - c) > width) {
+                    ok = BuildRow(out, len, n++);
+                    chars_new += len;
+                    len = (indent + (w - c) < DOC_COLS) ? indent : 0;
+                    memset(out, ' ', len);
+                    has_words = false;
+                }
+                if (has_words) {
+                    out[len++] = ' ';
+                }
+                memcpy(out + len, row + c, w - c);
+                len += w - c;
+                has_words = true;
+                c = w;
+            }
+        }
+        if (has_words && ok) {
+            ok = BuildRow(out, len, n++);
+            chars_new += len;
+        }
+        if (!ok) { // out of rows, so clear the rows built so far
+            memset(row, 0, DOC_COLS);
+            for (R = TheDoc.last_row+1; R < DOC_ROWS; R++) {
+                WriteStr(TheDoc.rows[R].ptxt, row, DOC_COLS);
+                TheDoc.rows[R].len = 0;
+            }
+            return false;
+        }
+        SpliceRows(first, last, n);
+        TheDoc.num_chars += chars_new - chars_old; // word count doesn't change
+        return true;
+    }
+    return false;
+}
+
 // ---------------------------------------------------------------------------
 // Append a string to row[row_index], if the result isn't too long
 // NOTE: the str should have no tailing '\n'
@@ -269,10 +902,13 @@ bool AppendString(char * str, uint16_t row_index)
             if (len_result < DOC_COLS) { // fits?
                 char row[DOC_COLS] = {0};
                 ReadStr(TheDoc.rows[row_index].ptxt, row, TheDoc.rows[row_index].len);
+                CountRowStats(row, len_row, false);
                 strncat(row, str, DOC_COLS-TheDoc.rows[row_index].len);
+                CountRowStats(row, len_result, true);
                 row[len_result] = '\n';
                 WriteStr(TheDoc.rows[row_index].ptxt, row, DOC_COLS);
                 TheDoc.rows[row_index].len = len_result;
+                LexRowsChanged(row_index, row_index);
 				TheDoc.dirty = true;
                 return true;
             }
@@ -9,19 +9,33 @@
 #include <stdbool.h>
 #include <stdlib.h>
 
-// doc uses extended mem 0x11300 to 0x1FAFF
-#define DOC_MEM_START 0x1300
-#define DOC_MEM_SIZE 0xE800 // 58k
+// doc uses extended mem 0x2700 to 0xF8FF, past the 80x62 canvas
+#define DOC_MEM_START 0x2700
+#define DOC_MEM_SIZE 0xD200 // 52k
 #define DOC_COLS 0x50 // 80
-#define DOC_ROWS 0x2E6 // 742
+#define DOC_ROWS 0x29F // 671
 
-#define DOC_ROWS_DISPLAYED 28
+#define DOC_ROWS_DISPLAYED 58 // most text rows shown, with the 8x8 font
+
+#define REFLOW_COLS 72 // width paragraphs are reflowed to, until another is set
 
 #define MAX_FILENAME 31
 
+#define NUM_BOOKMARKS 9 // Ctrl+1 to Ctrl+9
+#define NO_BOOKMARK 0xFFFF
+#define NO_LEX_ROW 0xFFFF // lex_from when no rows need re-lexing
+
+#define MAX_FOLDS 16
+
+typedef struct doc_fold {
+    uint16_t first; // row shown for the fold
+    uint16_t last; // rows first+1 to last are hidden
+} doc_fold_t;
+
 typedef struct doc_row {
     void * ptxt; // address of (extended) memory for row data
     uint8_t len; // number of valid chars in row, including '\n'
+    uint8_t lex; // syntax lexer state at row end (syntax.h)
 } doc_row_t;
 
 typedef struct doc {
@@ -29,16 +43,35 @@ typedef struct doc {
     uint8_t cur_filename_c; // cursor col in filename
     uint16_t cursor_r; // cursor row in document
     uint16_t cursor_c; // cursor col in document
-    uint16_t offset_r; // offset to row displayed
     uint16_t last_row; // last row used for doc
+    uint16_t num_chars; // chars in doc, not counting '\n's
+    uint16_t num_words; // runs of non-blank chars in doc
     bool dirty; // true if doc needs to be saved
+    bool auto_indent; // true if new lines copy the leading whitespace of the split row
     char filename[MAX_FILENAME+1];
+    uint16_t bookmarks[NUM_BOOKMARKS]; // bookmarked rows, or NO_BOOKMARK
+    uint16_t lex_from; // rows lex_from to lex_to changed since they were
+    uint16_t lex_to;   // lexed, or lex_from is NO_LEX_ROW
+    uint8_t num_folds;
+    doc_fold_t folds[MAX_FOLDS]; // sorted by first row, none overlapping
     doc_row_t * rows; // DOC_MEM_START
 } doc_t;
 
 extern doc_t TheDoc;
 
 void ClearDoc(bool save_filename);
+void ClearBookmarks(void);
+void ClearFolds(void);
+bool AddFold(uint16_t first, uint16_t last);
+bool RemoveFold(uint16_t first);
+bool FindFoldRange(uint16_t R, uint16_t * plast);
+uint16_t FoldEnd(uint16_t R);
+uint16_t FoldStart(uint16_t R);
+uint16_t StepShownRows(uint16_t R, int16_t n);
+void LexRowsChanged(uint16_t first, uint16_t last);
+bool BlankRow(uint16_t R);
+uint8_t CountWords(const char * str, uint8_t len);
+void CountRowStats(const char * str, uint8_t len, bool add);
 bool ReadStr(void * addr, char * str, uint8_t len);
 bool WriteStr(void * addr, char * str, uint8_t len);
 bool AddChar(char chr);
@@ -47,5 +80,10 @@ bool AddNewLine(void);
 bool AppendString(char * str, uint16_t row_index);
 bool AddRow(uint16_t row_index);
 bool DeleteRow(uint16_t row_index);
+bool MoveRows(uint16_t first, uint16_t last, bool up);
+bool DuplicateRows(uint16_t first, uint16_t last);
+bool DeleteRows(uint16_t first, uint16_t last);
+bool JoinRows(uint16_t first, uint16_t last);
+bool ReflowRows(uint16_t first, uint16_t last, uint8_t width);
 
 #endif // DOC_H
\ No newline at end of file
@@ -50,7 +50,7 @@ file_dlg_t * NewFileDlg(file_dlg_type_t type, char * msg)
             pfile_dlg->panel.btn_addr[i] = NULL;
             pfile_dlg->panel.action[i] = NULL;
         }
-        pfile_dlg->panel.pstash = NULL;
+        pfile_dlg->panel.shown = false;
 
         // add buttons
         len_btns = 0;
@@ -89,12 +89,7 @@ void DeleteFileDlg(file_dlg_t * pfile_dlg)
     if (pfile_dlg != NULL) {
         uint8_t i;
 
-        if (pfile_dlg->panel.pstash != NULL) {
-            RestoreChars(pfile_dlg->panel.r, pfile_dlg->panel.c, pfile_dlg->panel.w, pfile_dlg->panel.h, pfile_dlg->panel.pstash);
-
-            free(pfile_dlg->panel.pstash);
-            pfile_dlg->panel.pstash = NULL;
-        }
+        pfile_dlg->panel.shown = false;
 
         for (i = 0; i < pfile_dlg->panel.num_btns; i++) {
             button_t * btn = pfile_dlg->panel.btn_addr[i];
@@ -104,7 +99,7 @@ void DeleteFileDlg(file_dlg_t * pfile_dlg)
             }
         }
 
-        set_popup(NULL);
+        set_popup(NULL); // closes the overlay
         set_popup_type(NO_POPUP_TYPE);
 
         free(pfile_dlg);
@@ -120,44 +115,33 @@ void DeleteFileDlg(file_dlg_t * pfile_dlg)
 bool ShowFileDlg(file_dlg_t * pfile_dlg, uint8_t row, uint8_t col)
 {
     if (pfile_dlg != NULL) {
-        uint16_t bytes;
-        uint8_t i, r, c, start, len;
+        uint8_t r, start, len;
 
-        if (pfile_dlg->panel.pstash == NULL &&
+        if (!pfile_dlg->panel.shown &&
             row + pfile_dlg->panel.h < canvas_rows() &&
             col + pfile_dlg->panel.w < canvas_cols()   ) {
 
             pfile_dlg->panel.r = row;
             pfile_dlg->panel.c = col;
 
-            // backup display covered by panel (4bpp takes 2 bytes each char)
-            bytes = pfile_dlg->panel.w*pfile_dlg->panel.h*2;
-            pfile_dlg->panel.pstash = (uint8_t *)malloc(bytes);
-            if (pfile_dlg->panel.pstash != NULL) {
-                memset(pfile_dlg->panel.pstash, 0, pfile_dlg->panel.w*pfile_dlg->panel.h*2);
-                BackupChars(pfile_dlg->panel.r, pfile_dlg->panel.c, pfile_dlg->panel.w, pfile_dlg->panel.h, pfile_dlg->panel.pstash);
+            // draw on the overlay, so the display under it is left as is
+            if (OpenOverlay(pfile_dlg->panel.r, pfile_dlg->panel.c, pfile_dlg->panel.w, pfile_dlg->panel.h)) {
+                pfile_dlg->panel.shown = true;
 
                 // draw panel background
                 for (r = pfile_dlg->panel.r; r < pfile_dlg->panel.r + pfile_dlg->panel.h; r++) {
-                    for (c = pfile_dlg->panel.c; c < pfile_dlg->panel.c + pfile_dlg->panel.w; c++) {
-                        DrawChar(r, c, ' ', pfile_dlg->panel.bg, pfile_dlg->panel.fg);
-                    }
+                    FillSpan(r, pfile_dlg->panel.c, ' ', pfile_dlg->panel.w, pfile_dlg->panel.bg, pfile_dlg->panel.fg);
                 }
 
                 // draw the dialog message
                 len  = strlen(pfile_dlg->dlg_msg);
                 start = pfile_dlg->panel.c + (pfile_dlg->panel.w - len)/2;
-                i = 0;
-                for (c = start; c < (start + len); c++) {
-                    DrawChar(pfile_dlg->panel.r + 1, c, pfile_dlg->dlg_msg[i++], pfile_dlg->panel.bg, pfile_dlg->panel.fg);
-                }
+                DrawSpan(pfile_dlg->panel.r + 1, start, pfile_dlg->dlg_msg, len, pfile_dlg->panel.bg, pfile_dlg->panel.fg);
 
                 // draw the filename
                 len  = strlen(TheDoc.filename);
-                i = 0;
-                for (c = pfile_dlg->panel.c + 1; c < pfile_dlg->panel.c + pfile_dlg->panel.w - 1; c++) {
-                    DrawChar(pfile_dlg->panel.r + 3, c,  TheDoc.filename[i++], BLACK, WHITE);
-                }
+                DrawSpan(pfile_dlg->panel.r + 3, pfile_dlg->panel.c + 1, TheDoc.filename, len, BLACK, WHITE);
+                FillSpan(pfile_dlg->panel.r + 3, pfile_dlg->panel.c + 1 + len, ' ', pfile_dlg->panel.w - 2 - len, BLACK, WHITE);
 
                 // initialize doc filename cursor locations
                 TheDoc.cur_filename_r = pfile_dlg->panel.r + 3;
@@ -171,7 +155,7 @@ bool ShowFileDlg(file_dlg_t * pfile_dlg, uint8_t row, uint8_t col)
                     ShowButton(pfile_dlg->panel.btn_addr[1], pfile_dlg->panel.r + 5, pfile_dlg->panel.c + (pfile_dlg->panel.w - 15)/2 + 7);
                     return true;
                 }
-            } // stash allocation failed
+            } // too big for overlay
             return false;
         }
     } // bad parameters
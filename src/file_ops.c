@@ -18,6 +18,8 @@
 #include "textbox.h"
 #include "statusbar.h"
 #include "panel.h"
+#include "syntax.h"
+#include "hex.h"
 #include "file_ops.h"
 
 static char msg[MAX_STATUS_MSG+1] = {0};
@@ -33,9 +35,24 @@ void OpenFile()
         int16_t retval = EINVAL;
         uint16_t offset = 0;
         uint16_t wrapped_file_lines = 0;
-        int16_t fd = open(TheDoc.filename, O_RDONLY);
+        int16_t fd;
+        CloseHexView();
+        fd = open(TheDoc.filename, O_RDONLY);
         if (fd >= 0) {
             uint16_t r;
+            // binary files are shown in hex, paged in from the file as shown
+            retval = read(fd, buf, DOC_COLS);
+            if (retval >= 0 && BinaryFile(TheDoc.filename, buf, retval)) {
+                OpenHexView(fd);
+                return;
+            }
+            if (lseek(fd, 0, SEEK_SET) < 0) {
+                ReportFileError();
+            }
+            TheDoc.num_chars = 0;
+            TheDoc.num_words = 0;
+            ClearBookmarks();
+            ClearFolds();
             for (r = 0; r < DOC_ROWS; r++) {
                 memset(buf, 0, DOC_COLS);
                 memset(row, 0, DOC_COLS);
@@ -68,6 +85,7 @@ void OpenFile()
                     TheDoc.rows[r].len = strlen(row)-1; // don't count '\n'
                     //printf("r=%u, %s", r, row);
                     WriteStr(TheDoc.rows[r].ptxt, row, TheDoc.rows[r].len+1); // copy '\n' too
+                    CountRowStats(row, TheDoc.rows[r].len, true);
                     TheDoc.last_row = r;
 
                     // set file pointer to start of next row text
@@ -84,9 +102,9 @@ void OpenFile()
             if (close(fd) < 0) {
                 ReportFileError();
             }
-            for (r = 0; r < TheTextbox.h; r++) {
-                TheTextbox.row_dirty[r] = true;
-            }
+            LexRowsChanged(0, TheDoc.last_row); // the rows' cached states are the old doc's
+            InitSyntax();
+            SetAllTextboxRowsDirty();
         } else {
             ReportFileError();
         }
@@ -101,6 +119,10 @@ static void SaveFile(bool fail_if_exists)
     int16_t flags = fail_if_exists ? (O_WRONLY|O_CREAT|O_EXCL|O_TRUNC)
                                    : (O_WRONLY|O_TRUNC);
     //printf("SaveFile: Filename = %s\n", TheDoc.filename);
+    if (HexView()) { // only the edited blocks are written back
+        SaveHexFile(fail_if_exists);
+        return;
+    }
     fd = open(TheDoc.filename, flags);
     if (fd >= 0) {
         uint16_t r;
@@ -127,6 +149,7 @@ static void SaveFile(bool fail_if_exists)
         }
         close(fd);
         TheDoc.dirty = false;
+        InitSyntax(); // the extension may have changed
     } else {
         if (errno == 0 || errno == FR_EXIST) {
             // bug: open() always sets errno to 0
@@ -0,0 +1,472 @@
+// ---------------------------------------------------------------------------
+// hex.c
+// ---------------------------------------------------------------------------
+
+#include <rp6502.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#ifdef __CC65__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <errno.h>
+#include <string.h>
+#include "colors.h"
+#include "doc.h"
+#include "display.h"
+#include "textbox.h"
+#include "statusbar.h"
+#include "hex.h"
+
+// A binary file is shown HEX_ROW_BYTES bytes a row, in hex and as chars,
+// over the whole textbox, and edited in place. It is never read in whole:
+// its HEX_BLOCK byte blocks are read as they're shown, straight into slots
+// in the doc's XRAM, which is free as the doc is kept empty meanwhile.
+// Edited slots are kept until saved, when only they are written back, and
+// the others are reused in clock order.
+#define HEX_SLOTS (DOC_MEM_SIZE/HEX_BLOCK)
+#define HEX_MAX_SIZE ((uint32_t)NO_BLOCK*HEX_BLOCK)
+#define NO_BLOCK 0xFFFF // slot_block of an unused slot
+#define NO_SLOT 0xFF
+#define SLOT_USED 1 // shown or edited since the clock hand last passed it
+#define SLOT_DIRTY 2 // edited since saved
+#define NO_HEX_ROW 0xFFFFFFFF // row_shown of a row that must be drawn
+#define OFFSET_W 8 // "0001A2F0", the offset of the row's first byte
+#define HEX_COL 10 // "41 42 ..", with a gap after the 8th byte
+#define CHAR_COL 61 // "AB..", the same bytes as chars
+#define HEX_ROWS_PER_FRAME 4 // rows drawn per frame, about the textbox's budget
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+static int16_t hex_fd = -1; // the file shown, kept open to read, -1 if none
+static char hex_name[MAX_FILENAME+1] = {0}; // and its name
+static uint32_t hex_size = 0;
+static uint32_t hex_top = 0; // offset of the first byte of the top row
+static uint32_t hex_cursor = 0;
+static uint8_t hex_nibble = 0; // 1 if typing goes to the cursor byte's low digit
+static bool hex_chars = false; // if typing goes to the chars, not the hex
+static uint16_t slot_block[HEX_SLOTS]; // block of the file each slot holds
+static uint8_t slot_flags[HEX_SLOTS];
+static uint8_t clock_hand = 0;
+static uint8_t last_slot = 0; // of the last block looked up, most likely the next
+static uint32_t row_shown[DOC_ROWS_DISPLAYED]; // offset each display row shows
+
+#define SlotAddr(i) (DOC_MEM_START + (uint16_t)(i)*HEX_BLOCK)
+
+// ---------------------------------------------------------------------------
+// Returns how many bytes of the file are in block b, HEX_BLOCK but the last
+// ---------------------------------------------------------------------------
+static uint16_t BlockLen(uint16_t b)
+{
+    uint32_t pos = (uint32_t)b*HEX_BLOCK;
+    return (hex_size - pos < HEX_BLOCK) ? (uint16_t)(hex_size - pos) : HEX_BLOCK;
+}
+
+// ---------------------------------------------------------------------------
+// Returns the slot holding block b, reading it into the first slot the
+// clock hand finds neither edited nor used since it last passed, or
+// NO_SLOT if every slot is edited or the read failed
+// ---------------------------------------------------------------------------
+static uint8_t SlotOf(uint16_t b)
+{
+    uint16_t n;
+    uint8_t i;
+    if (slot_block[last_slot] == b) {
+        slot_flags[last_slot] |= SLOT_USED;
+        return last_slot;
+    }
+    for (i = 0; i < HEX_SLOTS; i++) {
+        if (slot_block[i] == b) {
+            slot_flags[i] |= SLOT_USED;
+            last_slot = i;
+            return i;
+        }
+    }
+    for (n = 0; n < 2*HEX_SLOTS; n++) {
+        i = clock_hand;
+        clock_hand = (clock_hand+1 < HEX_SLOTS) ? clock_hand+1 : 0;
+        if ((slot_flags[i] & SLOT_DIRTY) == 0) {
+            if ((slot_flags[i] & SLOT_USED) == 0) {
+                slot_block[i] = NO_BLOCK;
+                if (lseek(hex_fd, (uint32_t)b*HEX_BLOCK, SEEK_SET) < 0 ||
+                    read_xram(SlotAddr(i), BlockLen(b), hex_fd) < 0) {
+                    ReportFileError();
+                    return NO_SLOT;
+                }
+                slot_block[i] = b;
+                slot_flags[i] = SLOT_USED;
+                last_slot = i;
+                return i;
+            }
+            slot_flags[i] &= ~SLOT_USED;
+        }
+    }
+    UpdateStatusBarMsg("Too many changes to keep, save them first!", STATUS_WARNING);
+    return NO_SLOT;
+}
+
+// ---------------------------------------------------------------------------
+// Returns true if the file is binary, going by its extension or by the
+// control chars in its first n bytes, head. Bytes 0x80 and up are text.
+// ---------------------------------------------------------------------------
+bool BinaryFile(const char * filename, const char * head, int16_t n)
+{
+    const char * dot = strrchr(filename, '.');
+    int16_t i;
+    if (dot != NULL && strlen(dot) <= 7) {
+        char ext[8];
+        for (i = 0; i < 8; i++) {
+            ext[i] = (dot[i] >= 'A' && dot[i] <= 'Z') ? dot[i] | 0x20 : dot[i];
+        }
+        if (strcmp(ext, ".rp6502") == 0 || strcmp(ext, ".bin") == 0 ||
+            strcmp(ext, ".rom") == 0) {
+            return true;
+        }
+    }
+    for (i = 0; i < n; i++) {
+        uint8_t ch = head[i];
+        if (ch < ' ' && ch != '\t' && ch != '\r' && ch != '\n') {
+            return true;
+        }
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Shows the file open on fd in hex, keeping fd open, over the whole textbox.
+// The doc is cleared, as its XRAM holds the file's blocks meanwhile.
+// ---------------------------------------------------------------------------
+bool OpenHexView(int16_t fd)
+{
+    int32_t size = lseek(fd, 0, SEEK_END);
+    uint8_t i;
+    if (size < 0 || (uint32_t)size > HEX_MAX_SIZE) {
+        if (size < 0) {
+            ReportFileError();
+        } else {
+            UpdateStatusBarMsg("File too big for the hex view!", STATUS_ERROR);
+        }
+        close(fd);
+        return false;
+    }
+    SplitTextbox(false);
+    ClearDoc(true);
+    hex_fd = fd;
+    strncpy(hex_name, TheDoc.filename, MAX_FILENAME);
+    hex_size = size;
+    hex_top = 0;
+    hex_cursor = 0;
+    hex_nibble = 0;
+    hex_chars = false;
+    for (i = 0; i < HEX_SLOTS; i++) {
+        slot_block[i] = NO_BLOCK;
+        slot_flags[i] = 0;
+    }
+    clock_hand = 0;
+    last_slot = 0;
+    for (i = 0; i < DOC_ROWS_DISPLAYED; i++) {
+        row_shown[i] = NO_HEX_ROW;
+    }
+    UpdateStatusBarMsg("Binary file, shown in hex. Tab switches to the chars.", STATUS_INFO);
+    UpdateCursor();
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Closes the file shown in hex, if any, and has the textbox drawn again
+// ---------------------------------------------------------------------------
+void CloseHexView(void)
+{
+    if (hex_fd >= 0) {
+        close(hex_fd);
+        hex_fd = -1;
+        ClearDoc(true); // the blocks are still in the doc's XRAM
+        RedrawAllPanes();
+    }
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+bool HexView(void)
+{
+    return hex_fd >= 0;
+}
+
+// ---------------------------------------------------------------------------
+// Writes the edited blocks back to the file, in place, or every block to
+// a new file, TheDoc.filename, which is then the one shown. The file shown
+// is closed while it's written, so it's open once only.
+// ---------------------------------------------------------------------------
+void SaveHexFile(bool new_file)
+{
+    int16_t fd;
+    uint16_t b, num_blocks = (hex_size + HEX_BLOCK-1) / HEX_BLOCK;
+    uint8_t i;
+    bool failed = false;
+    if (!new_file) {
+        close(hex_fd);
+    }
+    fd = open(TheDoc.filename, new_file ? (O_WRONLY|O_CREAT|O_EXCL) : O_WRONLY);
+    if (fd >= 0) {
+        if (new_file) {
+            for (b = 0; b < num_blocks && !failed; b++) {
+                i = SlotOf(b);
+                failed = (i == NO_SLOT || write_xram(SlotAddr(i), BlockLen(b), fd) < 0);
+            }
+        } else {
+            for (i = 0; i < HEX_SLOTS && !failed; i++) {
+                if ((slot_flags[i] & SLOT_DIRTY) != 0) {
+                    b = slot_block[i];
+                    failed = (lseek(fd, (uint32_t)b*HEX_BLOCK, SEEK_SET) < 0 ||
+                              write_xram(SlotAddr(i), BlockLen(b), fd) < 0);
+                }
+            }
+        }
+        if (failed) {
+            ReportFileError();
+        } else {
+            for (i = 0; i < HEX_SLOTS; i++) {
+                slot_flags[i] &= ~SLOT_DIRTY;
+            }
+            TheDoc.dirty = false;
+            strncpy(hex_name, TheDoc.filename, MAX_FILENAME);
+        }
+        close(fd);
+    } else {
+        if (errno != 0) {
+            ReportFileError();
+        } else if (new_file) { // bug: open() always sets errno to 0
+            errno = FR_EXIST; // probably, with O_EXCL
+            ReportFileError();
+        } else {
+            UpdateStatusBarMsg("Couldn't reopen the file to save it!", STATUS_ERROR);
+        }
+    }
+    if (failed || fd < 0) { // the file still shown, and saved to next time
+        strncpy(TheDoc.filename, hex_name, MAX_FILENAME);
+    }
+    if (new_file && !failed && fd >= 0) {
+        close(hex_fd);
+    }
+    if (!new_file || (!failed && fd >= 0)) {
+        hex_fd = open(hex_name, O_RDONLY);
+        if (hex_fd < 0) {
+            ReportFileError();
+            hex_fd = -1;
+            ClearDoc(true);
+            RedrawAllPanes();
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Draws display row r of the textbox, the row of bytes from hex_top on
+// ---------------------------------------------------------------------------
+static void DrawHexRow(uint8_t r)
+{
+    char row[DOC_COLS];
+    char bytes[HEX_ROW_BYTES];
+    uint32_t pos = hex_top + (uint32_t)r*HEX_ROW_BYTES;
+    uint8_t i, n = 0;
+    memset(row, ' ', DOC_COLS);
+    if (pos < hex_size) {
+        uint8_t slot = SlotOf(pos / HEX_BLOCK);
+        if (slot != NO_SLOT) {
+            n = (hex_size - pos < HEX_ROW_BYTES) ? (uint8_t)(hex_size - pos) : HEX_ROW_BYTES;
+            ReadStr((void*)(SlotAddr(slot) + (uint16_t)(pos % HEX_BLOCK)), bytes, n);
+        }
+        for (i = 0; i < OFFSET_W; i++) {
+            row[i] = hex_digits[(pos >> (4*(OFFSET_W-1-i))) & 0xF];
+        }
+    }
+    for (i = 0; i < n; i++) {
+        uint8_t ch = bytes[i];
+        uint8_t c = HEX_COL + 3*i + ((i < HEX_ROW_BYTES/2) ? 0 : 1);
+        row[c] = hex_digits[ch >> 4];
+        row[c+1] = hex_digits[ch & 0xF];
+        row[CHAR_COL + i] = (ch < ' ' || ch == 0x7F) ? '.' : ch;
+    }
+    DrawBeneathOverlay(true);
+    DrawSpan(TheTextbox->r + r, 0, row, OFFSET_W, TheTextbox->bg, DARK_GRAY);
+    DrawSpan(TheTextbox->r + r, OFFSET_W, row + OFFSET_W, canvas_cols() - OFFSET_W,
+             TheTextbox->bg, TheTextbox->fg);
+    DrawBeneathOverlay(false);
+    row_shown[r] = pos;
+}
+
+// ---------------------------------------------------------------------------
+// Called by UpdateTextbox every frame in hex view, to draw up to
+// HEX_ROWS_PER_FRAME of the rows that don't show what they should
+// ---------------------------------------------------------------------------
+void UpdateHexView(void)
+{
+    uint8_t r, n = 0;
+    for (r = 0; r < TheTextbox->h && n < HEX_ROWS_PER_FRAME; r++) {
+        if (row_shown[r] != hex_top + (uint32_t)r*HEX_ROW_BYTES) {
+            DrawHexRow(r);
+            n++;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Scrolls so the row from offset top is at the top. Scrolls of less than
+// the textbox's height move its text rows ring in hardware, and the rows
+// scrolled into view are drawn right away.
+// ---------------------------------------------------------------------------
+static void ScrollHexTo(uint32_t top)
+{
+    int32_t n = ((int32_t)top - (int32_t)hex_top) / HEX_ROW_BYTES;
+    uint8_t h = TheTextbox->h;
+    uint8_t r;
+    if (n == 0) {
+        return;
+    }
+    hex_top = top;
+    if (n <= -(int32_t)h || n >= (int32_t)h) {
+        return; // every row is drawn again, by UpdateHexView
+    }
+    ScrollTextRows(TheTextbox->ring, (int8_t)n);
+    if (n > 0) {
+        memmove(&row_shown[0], &row_shown[n], (h-n)*sizeof(uint32_t));
+        for (r = h-n; r < h; r++) {
+            DrawHexRow(r);
+        }
+    } else {
+        memmove(&row_shown[-n], &row_shown[0], (h+n)*sizeof(uint32_t));
+        for (r = 0; r < -n; r++) {
+            DrawHexRow(r);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Returns the offset of the top row for the file's last row to be at the
+// textbox's bottom, or 0 if it all fits
+// ---------------------------------------------------------------------------
+static uint32_t LastHexTop(void)
+{
+    uint32_t span = (uint32_t)(TheTextbox->h-1)*HEX_ROW_BYTES;
+    uint32_t last = (hex_size > 0) ? (hex_size-1) & ~(uint32_t)(HEX_ROW_BYTES-1) : 0;
+    return (last > span) ? last - span : 0;
+}
+
+// ---------------------------------------------------------------------------
+// Returns the display row and col the cursor shows on, the row being
+// outside the textbox if it's scrolled out of view
+// ---------------------------------------------------------------------------
+void HexCursorCell(int16_t * prow, uint8_t * pcol)
+{
+    uint8_t i = hex_cursor % HEX_ROW_BYTES;
+    if (hex_cursor < hex_top) {
+        *prow = TheTextbox->r - 1;
+    } else if (hex_cursor - hex_top >= (uint32_t)TheTextbox->h*HEX_ROW_BYTES) {
+        *prow = TheTextbox->r + TheTextbox->h;
+    } else {
+        *prow = TheTextbox->r + (int16_t)((hex_cursor - hex_top) / HEX_ROW_BYTES);
+    }
+    *pcol = hex_chars ? CHAR_COL + i
+                      : HEX_COL + 3*i + ((i < HEX_ROW_BYTES/2) ? 0 : 1) + hex_nibble;
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+uint32_t HexCursor(void)
+{
+    return hex_cursor;
+}
+
+// ---------------------------------------------------------------------------
+// Moves the cursor n bytes, up to the file's ends, scrolling it into view
+// ---------------------------------------------------------------------------
+void MoveHexCursor(int32_t n)
+{
+    int32_t pos = (int32_t)hex_cursor + n;
+    uint32_t span = (uint32_t)(TheTextbox->h-1)*HEX_ROW_BYTES;
+    uint32_t row;
+    if (pos >= (int32_t)hex_size) {
+        pos = (int32_t)hex_size - 1;
+    }
+    hex_cursor = (pos > 0) ? pos : 0;
+    hex_nibble = 0;
+    row = hex_cursor & ~(uint32_t)(HEX_ROW_BYTES-1);
+    if (row < hex_top) {
+        ScrollHexTo(row);
+    } else if (row > hex_top + span) {
+        ScrollHexTo(row - span);
+    }
+    UpdateCursor();
+}
+
+// ---------------------------------------------------------------------------
+// Scrolls n rows, down if n > 0, leaving the cursor where it is
+// ---------------------------------------------------------------------------
+void ScrollHexView(int16_t n)
+{
+    int32_t top = (int32_t)hex_top + (int32_t)n*HEX_ROW_BYTES;
+    uint32_t last = LastHexTop();
+    ScrollHexTo((top < 0) ? 0 : ((uint32_t)top > last) ? last : (uint32_t)top);
+    UpdateCursor();
+}
+
+// ---------------------------------------------------------------------------
+// Switches typing between the hex and the chars
+// ---------------------------------------------------------------------------
+void ToggleHexColumn(void)
+{
+    hex_chars = !hex_chars;
+    hex_nibble = 0;
+    UpdateCursor();
+}
+
+// ---------------------------------------------------------------------------
+// Overwrites the cursor byte with ch, or its hex digit with the one ch is,
+// and moves on. Returns false if ch isn't a hex digit when one is wanted,
+// or the byte couldn't be paged in.
+// ---------------------------------------------------------------------------
+bool TypeInHexView(char ch)
+{
+    uint8_t slot, digit;
+    char byte;
+    void * addr;
+    if (hex_cursor >= hex_size) { // an empty file
+        return false;
+    }
+    if (!hex_chars) {
+        if (ch >= '0' && ch <= '9') {
+            digit = ch - '0';
+        } else if ((ch | 0x20) >= 'a' && (ch | 0x20) <= 'f') {
+            digit = (ch | 0x20) - 'a' + 10;
+        } else {
+            return false;
+        }
+    }
+    slot = SlotOf(hex_cursor / HEX_BLOCK);
+    if (slot == NO_SLOT) {
+        return false;
+    }
+    addr = (void*)(SlotAddr(slot) + (uint16_t)(hex_cursor % HEX_BLOCK));
+    if (hex_chars) {
+        byte = ch;
+    } else {
+        ReadStr(addr, &byte, 1);
+        byte = (hex_nibble == 0) ? (byte & 0x0F) | (digit << 4) : (byte & 0xF0) | digit;
+    }
+    WriteStr(addr, &byte, 1);
+    slot_flags[slot] |= SLOT_DIRTY;
+    TheDoc.dirty = true;
+    if (hex_cursor >= hex_top) {
+        uint32_t r = (hex_cursor - hex_top) / HEX_ROW_BYTES;
+        if (r < TheTextbox->h) {
+            row_shown[r] = NO_HEX_ROW;
+        }
+    }
+    if (hex_chars || hex_nibble == 1) {
+        MoveHexCursor(1);
+    } else {
+        hex_nibble = 1;
+        UpdateCursor();
+    }
+    return true;
+}
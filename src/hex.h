@@ -0,0 +1,27 @@
+// ---------------------------------------------------------------------------
+// hex.h
+// ---------------------------------------------------------------------------
+
+#ifndef HEX_H
+#define HEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define HEX_BLOCK 256 // bytes of the file paged in at a time
+#define HEX_ROW_BYTES 16 // bytes shown per display row
+
+bool BinaryFile(const char * filename, const char * head, int16_t n);
+bool OpenHexView(int16_t fd);
+void CloseHexView(void);
+bool HexView(void);
+void SaveHexFile(bool new_file);
+void UpdateHexView(void);
+void HexCursorCell(int16_t * prow, uint8_t * pcol);
+uint32_t HexCursor(void);
+void MoveHexCursor(int32_t n);
+void ScrollHexView(int16_t n);
+void ToggleHexColumn(void);
+bool TypeInHexView(char ch);
+
+#endif // HEX_H
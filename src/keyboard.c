@@ -16,6 +16,7 @@
 #include "file_dlg.h"
 #include "actions.h"
 #include "menu.h"
+#include "hex.h"
 #include "usb_hid_keys.h"
 #include "keyboard.h"
 
@@ -43,6 +44,12 @@ static uint8_t keybuf_tail = 0;
 #define CAPSLK_MASK 0x20
 static uint8_t mode_keys = 0;
 
+// Alt+numpad codes: while Alt is held, the numpad digits typed, with num
+// lock on, make up a decimal code, and the char with that code is typed
+// once Alt is released, so any of the font's 256 glyphs can be typed
+static uint8_t compose_code = 0; // modulo 256, as on the PC
+static uint8_t compose_digits = 0; // typed so far, 0 if not composing
+
 static const char shifted[][2] = {{'a','A'}, // 4 = 0x04 (KEY_A)
                                   {'b','B'},
                                   {'c','C'},
@@ -248,6 +255,9 @@ static bool ProcessKeysInPopup(panel_t * popup, popup_type_t popup_type,
         } else if (key == KEY_P) { //  'P'aste
             RemoveFocusFromAllPanelButtons(&TheMainMenu);
             EditPaste();
+        } else if (key == KEY_I) { //  'I'ndent
+            RemoveFocusFromAllPanelButtons(&TheMainMenu);
+            EditAutoIndent();
         } /*else if (key == KEY_F) { //  'F'ind
             RemoveFocusFromAllPanelButtons(&TheMainMenu);
             EditFind();
@@ -259,6 +269,9 @@ static bool ProcessKeysInPopup(panel_t * popup, popup_type_t popup_type,
         if (key == KEY_A) {        //  'A'bout
             RemoveFocusFromAllPanelButtons(&TheMainMenu);
             HelpAbout();
+        } else if (key == KEY_S) { //  'S'tatistics
+            RemoveFocusFromAllPanelButtons(&TheMainMenu);
+            HelpStatistics();
         }
     }
 
@@ -308,7 +321,7 @@ static bool ProcessKeysInPopup(panel_t * popup, popup_type_t popup_type,
         }
     } else if (key == KEY_TAB) {
         if (popup_type == FILEDIALOG) {
-            if (TheTextbox.in_focus) {
+            if (TheTextbox->in_focus) {
                 UpdateTextboxFocus(false);
                 UpdateButtonFocus(popup->btn_addr[0], true);
             } else {
@@ -364,7 +377,7 @@ static bool ProcessKeysInPopup(panel_t * popup, popup_type_t popup_type,
                 RemoveFocusFromAllPanelButtons(&TheMainMenu);
                 DeletePanel(popup);
         }
-    } else if (popup_type == FILEDIALOG && TheTextbox.in_focus) {
+    } else if (popup_type == FILEDIALOG && TheTextbox->in_focus) {
         if (key == KEY_BACKSPACE || key == KEY_DELETE
                                     || (key == KEY_KPDOT && !(key_modes & NUMLK_MASK))) {
             DeleteCharFromFilename();
@@ -375,13 +388,80 @@ static bool ProcessKeysInPopup(panel_t * popup, popup_type_t popup_type,
     return retval;
 }
 
+// ----------------------------------------------------------------------------
+// Types ch at the cursor, any byte but 0, in the doc or the hex view
+// ----------------------------------------------------------------------------
+static void TypeChar(char ch)
+{
+    if (ch == 0) { // a key with no ASCII form
+        return;
+    }
+    if (HexView()) {
+        if (!TypeInHexView(ch)) {
+            UpdateStatusBarMsg("Byte not changed!", STATUS_WARNING);
+        }
+        return;
+    }
+    ClearMarkedText();
+    if (TheDoc.rows[TheDoc.cursor_r].len+1 < DOC_COLS) { // room to move right?
+        uint8_t c = TheDoc.cursor_c;
+        AddChar(ch);
+        // only the cells from the old cursor to the new row end changed
+        SetDocSpanDirty(TheDoc.cursor_r, c, TheDoc.rows[TheDoc.cursor_r].len-1);
+        ScrollToCursor(); // it may have wrapped onto the next row
+    } else {
+        UpdateStatusBarMsg("Maximum line length exceeded!", STATUS_WARNING);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Moves about a binary file shown in hex, a byte or row of 16 at a time, and
+// overwrites its bytes, in hex or as chars, Tab switching between them
+// ----------------------------------------------------------------------------
+static void ProcessKeysInHexView(uint8_t key_modes, uint8_t key)
+{
+    int32_t page = (int32_t)(TheTextbox->h-1)*HEX_ROW_BYTES;
+    uint8_t c = HexCursor() % HEX_ROW_BYTES;
+    if (key == KEY_UP || (key == KEY_KP8 && !(key_modes & NUMLK_MASK))) {
+        MoveHexCursor(-HEX_ROW_BYTES);
+    } else if (key == KEY_DOWN || (key == KEY_KP2 && !(key_modes & NUMLK_MASK))) {
+        MoveHexCursor(HEX_ROW_BYTES);
+    } else if (key == KEY_LEFT || key == KEY_BACKSPACE ||
+               (key == KEY_KP4 && !(key_modes & NUMLK_MASK))) {
+        MoveHexCursor(-1);
+    } else if (key == KEY_RIGHT || (key == KEY_KP6 && !(key_modes & NUMLK_MASK))) {
+        MoveHexCursor(1);
+    } else if (key == KEY_HOME || (key == KEY_KP7 && !(key_modes & NUMLK_MASK))) {
+        MoveHexCursor(-(int32_t)c);
+    } else if (key == KEY_END || (key == KEY_KP1 && !(key_modes & NUMLK_MASK))) {
+        MoveHexCursor(HEX_ROW_BYTES-1 - c);
+    } else if (key == KEY_PAGEUP || (key == KEY_KP9 && !(key_modes & NUMLK_MASK))) {
+        MoveHexCursor(-page);
+    } else if (key == KEY_PAGEDOWN || (key == KEY_KP3 && !(key_modes & NUMLK_MASK))) {
+        MoveHexCursor(page);
+    } else if (key == KEY_TAB) {
+        ToggleHexColumn();
+    } else if (key == KEY_ENTER || key == KEY_KPENTER || key == KEY_ESC ||
+               key == KEY_DELETE || key == KEY_KPDOT) {
+        // bytes are only overwritten, never added or deleted
+    } else {
+        TypeChar(HID2ASCII(key_modes, key));
+    }
+}
+
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
 static bool ProcessKeysInMainTextbox(uint8_t key_modes, uint8_t key)
 {
-    uint16_t r;
     uint8_t i, n;
     bool retval = true;
+    bool paging = (key == KEY_PAGEUP || key == KEY_PAGEDOWN ||
+                   ((key == KEY_KP9 || key == KEY_KP3) && !(key_modes & NUMLK_MASK)));
+    // keys see the textbox where any smooth scroll was going, but paging
+    // carries on from there without waiting
+    if (!paging) {
+        FinishGlide();
+    }
     if ((key_modes & CTRL_MASK)>0) { // Can use Ctrl+... accelerator keys
         if (key == KEY_O) { // File 'O'pen
             FileOpen();
@@ -395,13 +475,47 @@ static bool ProcessKeysInMainTextbox(uint8_t key_modes, uint8_t key)
             EditCopy();
         } else if (key == KEY_V) { // Edit Paste
             EditPaste();
+        } else if (key == KEY_I) { // Edit auto 'I'ndent
+            EditAutoIndent();
+        } else if (key == KEY_D) { // Edit 'D'uplicate line(s)
+            EditDuplicateLines();
+        } else if (key == KEY_K) { // Edit 'K'ill line(s)
+            EditDeleteLines();
+        } else if (key == KEY_J) { // Edit 'J'oin lines
+            EditJoinLines();
+        } else if (key == KEY_R) { // Edit 'R'eflow paragraph, or set its width
+            ((key_modes & SHIFT_MASK)>0) ? EditSetReflowWidth() : EditReflowLines();
+        } else if (key == KEY_U) { // Edit fold, or 'U'nfold, lines
+            EditFoldLines();
+        } else if (key == KEY_L) { // View 'L'ine numbers
+            ViewLineNumbers();
+        } else if (key == KEY_B) { // View scroll'B'ar
+            ViewScrollbar();
+        } else if (key == KEY_W) { // View split 'W'indow
+            ViewSplit();
+        } else if (key == KEY_M) { // View 'M'ore text rows
+            ViewDenseText();
+        } else if (key == KEY_G) { // View 'G'liding scroll
+            ViewSmoothScroll();
+        } else if (key == KEY_P) { // View wra'P'ped rows
+            ViewSoftWrap();
+        } else if (key == KEY_TAB) { // View other pane
+            ViewOtherPane();
+        } else if (key == KEY_T) { // Help statis'T'ics
+            HelpStatistics();
+        } else if (key >= KEY_1 && key <= KEY_9) { // bookmarks
+            ((key_modes & SHIFT_MASK)>0) ? EditSetBookmark(key - KEY_1)
+                                         : EditGotoBookmark(key - KEY_1);
         } /*else if (key == KEY_F) { // Edit Find
             EditFind();
         } else if (key == KEY_H) { // Edit Replace
             EditReplace();
         }*/
     } else if (((key_modes & ALT_MASK)>0)) { // open main menu submenus
-        if (key == KEY_F) { // 'F'ile
+        if (((key_modes & NUMLK_MASK)>0) && (key >= KEY_KP1 && key <= KEY_KP0)) {
+            compose_code = compose_code*10 + (numpad_hid_2_ascii(key) - '0');
+            compose_digits++;
+        } else if (key == KEY_F) { // 'F'ile
             CloseAnyPopupMenu();
             RemoveFocusFromAllPanelButtons(&TheMainMenu);
             UpdateButtonFocus(TheMainMenu.btn_addr[0], true);
@@ -416,36 +530,26 @@ static bool ProcessKeysInMainTextbox(uint8_t key_modes, uint8_t key)
             RemoveFocusFromAllPanelButtons(&TheMainMenu);
             UpdateButtonFocus(TheMainMenu.btn_addr[2], true);
             ShowHelpSubmenu();
+        } else if (key == KEY_UP || (key == KEY_KP8 && !(key_modes & NUMLK_MASK))) {
+            EditMoveLinesUp();
+        } else if (key == KEY_DOWN || (key == KEY_KP2 && !(key_modes & NUMLK_MASK))) {
+            EditMoveLinesDown();
         }
+    } else if (HexView()) { // a binary file is shown instead of the doc
+        ProcessKeysInHexView(key_modes, key);
     } else if (key == KEY_UP || (key == KEY_KP8 && !(key_modes & NUMLK_MASK))) {
-        if (TheDoc.cursor_r > 0) { // room to move up
-            // if the cursor is at top of display, scroll by adjusting doc offset
-            if (TheDoc.cursor_r-1 < TheDoc.offset_r) {
-                SetAllTextboxRowsDirty();
-                TheDoc.offset_r--;
-            }
-            TheDoc.cursor_r -= 1;
+        if (MoveCursorLine(false)) { // room to move up, scrolling if at the top
             if ((key_modes & SHIFT_MASK)>0) {
                 MarkText();
-                TheTextbox.row_dirty[TheDoc.cursor_r-TheDoc.offset_r] = true;
-                TheTextbox.row_dirty[TheDoc.cursor_r-TheDoc.offset_r+1] = true;
             } else {
                 ClearMarkedText();
             }
             UpdateCursor();
         }
     } else if (key == KEY_DOWN || (key == KEY_KP2 && !(key_modes & NUMLK_MASK))) {
-        if (TheDoc.cursor_r < TheDoc.last_row) { // room to move down
-            // if the cursor is at bottom of display, scroll by adjusting doc offset
-            if (TheDoc.cursor_r+1 > TheTextbox.h-1+TheDoc.offset_r) {
-                SetAllTextboxRowsDirty();
-                TheDoc.offset_r++;
-            }
-            TheDoc.cursor_r += 1;
+        if (MoveCursorLine(true)) { // room to move down, scrolling if at the bottom
             if ((key_modes & SHIFT_MASK)>0) {
                 MarkText();
-                TheTextbox.row_dirty[TheDoc.cursor_r-TheDoc.offset_r] = true;
-                TheTextbox.row_dirty[TheDoc.cursor_r-TheDoc.offset_r-1] = true;
             } else {
                 ClearMarkedText();
             }
@@ -456,7 +560,6 @@ static bool ProcessKeysInMainTextbox(uint8_t key_modes, uint8_t key)
             TheDoc.cursor_c -= 1;
             if ((key_modes & SHIFT_MASK)>0) {
                 MarkText();
-                TheTextbox.row_dirty[TheDoc.cursor_r-TheDoc.offset_r] = true;
             } else {
                 ClearMarkedText();
             }
@@ -467,7 +570,6 @@ static bool ProcessKeysInMainTextbox(uint8_t key_modes, uint8_t key)
             TheDoc.cursor_c += 1;
             if ((key_modes & SHIFT_MASK)>0) {
                 MarkText();
-                TheTextbox.row_dirty[TheDoc.cursor_r-TheDoc.offset_r] = true;
             } else {
                 ClearMarkedText();
             }
@@ -477,7 +579,6 @@ static bool ProcessKeysInMainTextbox(uint8_t key_modes, uint8_t key)
         TheDoc.cursor_c = 0;
         if ((key_modes & SHIFT_MASK)>0) {
             MarkText();
-            TheTextbox.row_dirty[TheDoc.cursor_r-TheDoc.offset_r] = true;
         } else {
             ClearMarkedText();
         }
@@ -486,51 +587,47 @@ static bool ProcessKeysInMainTextbox(uint8_t key_modes, uint8_t key)
         TheDoc.cursor_c = TheDoc.rows[TheDoc.cursor_r].len;
         if ((key_modes & SHIFT_MASK)>0) {
             MarkText();
-            TheTextbox.row_dirty[TheDoc.cursor_r-TheDoc.offset_r] = true;
         } else {
             ClearMarkedText();
         }
         UpdateCursor();
     } else if (key == KEY_PAGEUP || (key == KEY_KP9 && !(key_modes & NUMLK_MASK))) {
-        uint16_t old_offset = TheDoc.offset_r;
-        int16_t new_cursor_r = (int16_t)TheDoc.cursor_r - (int16_t)(TheTextbox.h-1);
-        new_cursor_r = (new_cursor_r >= 0) ? new_cursor_r : 0;
-        if (TheDoc.offset_r == 0 ||
+        uint16_t offset = TextboxScrollTarget();
+        uint16_t new_cursor_r = StepShownRows(TheDoc.cursor_r, -(int16_t)(TheTextbox->h-1));
+        ClearMarkedText();
+        if (offset == 0 ||
             new_cursor_r == 0 ||
-            TheDoc.offset_r == new_cursor_r ) {
+            offset == new_cursor_r ) {
             TheDoc.cursor_r = new_cursor_r;
-            TheDoc.offset_r = new_cursor_r;
+            GlideTextboxOffset(new_cursor_r);
         } else { // shift offset a full screen height
             TheDoc.cursor_r = new_cursor_r;
-            TheDoc.offset_r -= (TheTextbox.h-1);
+            GlideTextboxOffset(StepShownRows(offset, -(int16_t)(TheTextbox->h-1)));
         }
-        ClearMarkedText();
-        SetAllTextboxRowsDirty();
         UpdateCursor();
     } else if (key == KEY_PAGEDOWN || (key == KEY_KP3 && !(key_modes & NUMLK_MASK))) {
-        uint16_t old_offset = TheDoc.offset_r;
-        uint16_t old_offset_to_bottom = TheDoc.offset_r + (TheTextbox.h-1);
-        uint16_t new_cursor_r = TheDoc.cursor_r + (TheTextbox.h-1);
-        new_cursor_r = (new_cursor_r < TheDoc.last_row) ? new_cursor_r : TheDoc.last_row;
-        new_cursor_r = (new_cursor_r < DOC_ROWS-1) ? new_cursor_r : DOC_ROWS-1;
+        uint16_t offset = TextboxScrollTarget();
+        uint16_t old_offset_to_bottom = StepShownRows(offset, TheTextbox->h-1);
+        uint16_t new_cursor_r = StepShownRows(TheDoc.cursor_r, TheTextbox->h-1);
+        ClearMarkedText();
         if (old_offset_to_bottom >= new_cursor_r)  { // no scroll
             TheDoc.cursor_r = new_cursor_r;
         } else { // shift offset a full screen height
             TheDoc.cursor_r = new_cursor_r;
-            TheDoc.offset_r += (TheTextbox.h-1);
+            GlideTextboxOffset(StepShownRows(offset, TheTextbox->h-1));
         }
-        ClearMarkedText();
-        SetAllTextboxRowsDirty();
         UpdateCursor();
     } else if (key == KEY_TAB) {
         ClearMarkedText();
         if ((key_modes & SHIFT_MASK) == 0) { // shift right
             n = TABSIZE - TheDoc.cursor_c % TABSIZE;
             if (TheDoc.rows[TheDoc.cursor_r].len+n < DOC_COLS) { // room to move right?
+                uint8_t c = TheDoc.cursor_c;
                 for (i = 0; i < n; i++) {
                     AddChar(HID2ASCII(key_modes, KEY_SPACE));
                 }
-                TheTextbox.row_dirty[TheDoc.cursor_r - TheDoc.offset_r] = true;
+                SetDocSpanDirty(TheDoc.cursor_r, c, TheDoc.rows[TheDoc.cursor_r].len-1);
+                ScrollToCursor(); // it may have wrapped onto the next row
             } else {
                 UpdateStatusBarMsg("Maximum line length exceeded!", STATUS_WARNING);
             }
@@ -540,7 +637,8 @@ static bool ProcessKeysInMainTextbox(uint8_t key_modes, uint8_t key)
     } else if (key == KEY_ENTER || key == KEY_KPENTER) {
         ClearMarkedText();
         if(AddNewLine()) {
-            SetAllTextboxRowsDirty();
+            SetDocRowsDirty(TheDoc.cursor_r-1, DOC_ROWS); // rows below shifted down
+            ScrollToCursor();
         }
     } else if (key == KEY_ESC) {
         ClearMarkedText();
@@ -553,20 +651,13 @@ static bool ProcessKeysInMainTextbox(uint8_t key_modes, uint8_t key)
         DeleteChar(key == KEY_BACKSPACE);
         // did operation delete a row?
         if (row_deleted) {
-            for (r = TheDoc.cursor_r - TheDoc.offset_r; r < TheTextbox.h; r++) {
-                TheTextbox.row_dirty[r] = true;
-            }
-        } else { // only current row is affected
-            TheTextbox.row_dirty[TheDoc.cursor_r - TheDoc.offset_r] = true;
+            SetDocRowsDirty(TheDoc.cursor_r, DOC_ROWS); // rows below shifted up
+        } else { // only the current row from the cursor on is affected
+            SetDocSpanDirty(TheDoc.cursor_r, TheDoc.cursor_c, TheDoc.rows[TheDoc.cursor_r].len);
         }
+        ScrollToCursor();
     } else {
-        ClearMarkedText();
-        if (TheDoc.rows[TheDoc.cursor_r].len+1 < DOC_COLS) { // room to move right?
-            AddChar(HID2ASCII(key_modes, key));
-            TheTextbox.row_dirty[TheDoc.cursor_r - TheDoc.offset_r] = true;
-        } else {
-            UpdateStatusBarMsg("Maximum line length exceeded!", STATUS_WARNING);
-        }
+        TypeChar(HID2ASCII(key_modes, key));
     }
     UpdateStatusBarPos();
     return retval;
@@ -674,5 +765,21 @@ bool HandleKeys()
         key_timer = 0;
         initial_delay_counter = 0;
     }
+
+    // type the char composed with Alt+numpad, now Alt is released
+    if (compose_digits > 0 && !(mode_keys & ALT_MASK)) {
+        if (get_popup() == NULL && compose_code != 0) {
+            FinishGlide();
+            if (!HexView() && compose_code < ' ' && compose_code != '\t') {
+                // would break the row, or make the file open as binary
+                UpdateStatusBarMsg("Control chars can't be typed in text!", STATUS_WARNING);
+            } else {
+                TypeChar((char)compose_code);
+                UpdateStatusBarPos();
+            }
+        }
+        compose_code = 0;
+        compose_digits = 0;
+    }
     return retval;
 }
\ No newline at end of file
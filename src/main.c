@@ -17,14 +17,21 @@
 #include "keyboard.h"
 #include "mouse.h"
 
-// canvas_data = 0x0000 to 0x12BF (display.c)
-// DOC buffers = 0x1300 to 0xFAFF (doc.h)
+// canvas_data = 0x0000 to 0x26BF (display.c), 0x13FF with the 8x16 font
+// DOC buffers = 0x2700 to 0xF8FF (doc.h)
+// submenu images = 0xF900 to 0xFACB (menu.c)
+// overlay_data = 0xFB00 to 0xFDFF (display.c)
 #define MUSIC_CONFIG 0xFE00 // to 0xFE39 (requires 0x40 bytes mem)
+// cursor_data = 0xFE40 to 0xFE4F (textbox.c)
 // mouse_data = 0xFE60 to 0xFEC3 (mouse.c)
 // canvas_struct = 0xFF00 to 0xFF0F (display.c)
+// status_struct = 0xFF10 to 0xFF1F (display.c)
 // keybd_status = 0xFF20 to 0xFF3F (keyboard.c)
 // mouse_state = 0xFF40 to 0xFF44 (mouse.c)
 // mouse_struct = 0xFF50 to 0xFF5F (mouse.c)
+// text_struct = 0xFF60 to 0xFF6F, 0xFF80 to 0xFF8F (display.c)
+// cursor_struct = 0xFF70 to 0xFF7F (textbox.c)
+// overlay_struct = 0xFF90 to 0xFF9F (display.c)
 
 
 // ---------------------------------------------------------------------------
@@ -58,6 +65,7 @@ int main(void)
             }
 
             UpdateTextbox();
+            UpdateStatusBarFlags();
 
             // break out of loop if something returns false
             if (!HandleKeys() || !HandleMouse()) {
@@ -19,13 +19,21 @@ static panel_t * FileSubmenu = NULL;
 static panel_t * EditSubmenu = NULL;
 static panel_t * HelpSubmenu = NULL;
 
+// submenus' prerendered overlay cells, w*h*2 bytes each
+static const uint16_t file_image = 0xF900; // to 0xF9F9
+static const uint16_t edit_image = 0xFA00; // to 0xFA7F
+static const uint16_t help_image = 0xFA80; // to 0xFACB
+
+static bool InitFileSubmenu(void);
+static bool InitEditSubmenu(void);
+static bool InitHelpSubmenu(void);
+
 panel_t TheMainMenu;
 
 // ---------------------------------------------------------------------------
 // ---------------------------------------------------------------------------
 bool InitMainMenu(void)
 {
-    uint8_t i, c, start;
     // Init Main Menu panel parameters
     TheMainMenu.panel_type = NO_POPUP_TYPE;
     TheMainMenu.r = 0;
@@ -35,6 +43,8 @@ bool InitMainMenu(void)
     TheMainMenu.bg = DARK_BLUE;
     TheMainMenu.fg = LIGHT_GRAY;
     TheMainMenu.btn_layout = HORZ;
+    TheMainMenu.shown = false;
+    TheMainMenu.image = NO_PANEL_IMAGE;
 
     // Create the buttons. We will use local routines, not actions, for ButtonPressed()
     if (AddButtonToPanel(&TheMainMenu, "File", 0, DARK_BLUE, LIGHT_GRAY, BLUE, WHITE, CYAN, NULL) &&
@@ -44,19 +54,30 @@ bool InitMainMenu(void)
         return false;
     }
 
-    // draw Main Menu background
-    for (c = 0; c < canvas_cols(); c++) {
-        DrawChar(0, c, ' ', TheMainMenu.bg, TheMainMenu.fg);
+    // the submenus are built and drawn once, into XRAM, and kept
+    if (!InitFileSubmenu() || !InitEditSubmenu() || !InitHelpSubmenu()) {
+        return false;
     }
 
+    DrawMainMenu();
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void DrawMainMenu(void)
+{
+    uint8_t i, start;
+
+    // draw Main Menu background
+    FillSpan(0, 0, ' ', canvas_cols(), TheMainMenu.bg, TheMainMenu.fg);
+
     // draw the buttons
     start = 0;
     for (i = 0; i < TheMainMenu.num_btns; i++) {
         ShowButton(TheMainMenu.btn_addr[i], TheMainMenu.r, TheMainMenu.c + start);
         start += TheMainMenu.btn_addr[i]->w;
     }
-
-    return true;
 }
 
 // ---------------------------------------------------------------------------
@@ -74,7 +95,8 @@ static bool InitFileSubmenu(void)
             AddButtonToPanel(FileSubmenu, "Close                  ", 0,
                              BLUE, WHITE, DARK_CYAN, WHITE, CYAN, FileClose) &&
             AddButtonToPanel(FileSubmenu, "Exit             Ctrl+Q", 1,
-                             BLUE, WHITE, DARK_CYAN, WHITE, CYAN, FileExit)) {
+                             BLUE, WHITE, DARK_CYAN, WHITE, CYAN, FileExit) &&
+            PrerenderPanel(FileSubmenu, file_image, 1, 1)) {
            return true;
         } else {
             DeletePanel(FileSubmenu);
@@ -88,18 +110,21 @@ static bool InitFileSubmenu(void)
 // ---------------------------------------------------------------------------
 static bool InitEditSubmenu(void)
 {
-    EditSubmenu = NewPanel(SUBMENU, VERT, 16, 3/*5*/, BLUE, WHITE );
+    EditSubmenu = NewPanel(SUBMENU, VERT, 16, 4/*6*/, BLUE, WHITE );
     if (EditSubmenu != NULL) {
         if (AddButtonToPanel(EditSubmenu, "Cut     Ctrl+X", 2,
                              BLUE, WHITE, DARK_CYAN, WHITE, CYAN, EditCut) &&
             AddButtonToPanel(EditSubmenu, "Copy    Ctrl+C", 0,
                              BLUE, WHITE, DARK_CYAN, WHITE, CYAN, EditCopy) &&
             AddButtonToPanel(EditSubmenu, "Paste   Ctrl+V", 0,
-                             BLUE, WHITE, DARK_CYAN, WHITE, CYAN, EditPaste) /*&&
+                             BLUE, WHITE, DARK_CYAN, WHITE, CYAN, EditPaste) &&
+            AddButtonToPanel(EditSubmenu, "Indent  Ctrl+I", 0,
+                             BLUE, WHITE, DARK_CYAN, WHITE, CYAN, EditAutoIndent) && /*
             AddButtonToPanel(EditSubmenu, "Find    Ctrl+F", 0,
                              BLUE, WHITE, DARK_CYAN, WHITE, CYAN, EditFind) &&
             AddButtonToPanel(EditSubmenu, "Replace Ctrl+H", 0,
-                             BLUE, WHITE, DARK_CYAN, WHITE, CYAN, EditReplace) */) {
+                             BLUE, WHITE, DARK_CYAN, WHITE, CYAN, EditReplace) &&*/
+            PrerenderPanel(EditSubmenu, edit_image, 1, 8)) {
             return true;
         } else {
             DeletePanel(EditSubmenu);
@@ -113,11 +138,14 @@ static bool InitEditSubmenu(void)
 // ---------------------------------------------------------------------------
 static bool InitHelpSubmenu(void)
 {
-    HelpSubmenu = NewPanel(SUBMENU, VERT, 7, 1, BLUE, WHITE );
+    HelpSubmenu = NewPanel(SUBMENU, VERT, 19, 2, BLUE, WHITE );
     if (HelpSubmenu != NULL) {
         // add its buttons
-        if (AddButtonToPanel(HelpSubmenu, "About", 0,
-                             BLUE, WHITE, DARK_CYAN, WHITE, CYAN, HelpAbout)) {
+        if (AddButtonToPanel(HelpSubmenu, "About            ", 0,
+                             BLUE, WHITE, DARK_CYAN, WHITE, CYAN, HelpAbout) &&
+            AddButtonToPanel(HelpSubmenu, "Statistics Ctrl+T", 0,
+                             BLUE, WHITE, DARK_CYAN, WHITE, CYAN, HelpStatistics) &&
+            PrerenderPanel(HelpSubmenu, help_image, 1, 8/*13*/)) {
             return true;
         } else {
             DeletePanel(HelpSubmenu);
@@ -132,12 +160,13 @@ static bool InitHelpSubmenu(void)
 // ---------------------------------------------------------------------------
 void ShowFileSubmenu(void)
 {
-    if (InitFileSubmenu()) {
+    if (FileSubmenu != NULL) {
         set_popup(FileSubmenu);
         set_popup_type(SUBMENU);
         UpdateTextboxFocus(false);
-        UpdateButtonFocus(FileSubmenu->btn_addr[0], true);
         ShowPanel(FileSubmenu, 1, 1);
+        RemoveFocusFromAllPanelButtons(FileSubmenu); // as left last time
+        UpdateButtonFocus(FileSubmenu->btn_addr[0], true);
     }
 }
 
@@ -146,12 +175,13 @@ void ShowFileSubmenu(void)
 // ---------------------------------------------------------------------------
 void ShowEditSubmenu(void)
 {
-    if (InitEditSubmenu()) {
+    if (EditSubmenu != NULL) {
         set_popup(EditSubmenu);
         set_popup_type(SUBMENU);
         UpdateTextboxFocus(false);
-        UpdateButtonFocus(EditSubmenu->btn_addr[0], true);
         ShowPanel(EditSubmenu, 1, 8);
+        RemoveFocusFromAllPanelButtons(EditSubmenu); // as left last time
+        UpdateButtonFocus(EditSubmenu->btn_addr[0], true);
     }
 }
 
@@ -160,12 +190,13 @@ void ShowEditSubmenu(void)
 // ---------------------------------------------------------------------------
 void ShowHelpSubmenu(void)
 {
-    if (InitHelpSubmenu()) {
+    if (HelpSubmenu != NULL) {
         set_popup(HelpSubmenu);
         set_popup_type(SUBMENU);
         UpdateTextboxFocus(false);
-        UpdateButtonFocus(HelpSubmenu->btn_addr[0], true);
         ShowPanel(HelpSubmenu, 1, 8/*13*/);
+        RemoveFocusFromAllPanelButtons(HelpSubmenu); // as left last time
+        UpdateButtonFocus(HelpSubmenu->btn_addr[0], true);
     }
 }
 
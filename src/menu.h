@@ -12,6 +12,7 @@
 extern panel_t TheMainMenu;
 
 bool InitMainMenu(void);
+void DrawMainMenu(void);
 
 void MainMenuButtonPressed(uint8_t index);
 uint8_t SubmenuShowing(void);
@@ -14,9 +14,11 @@
 #include "file_dlg.h"
 #include "actions.h"
 #include "menu.h"
+#include "hex.h"
 #include "mouse.h"
 
 #define MOUSE_DIV 1 // Mouse speed divider
+#define WHEEL_ROWS 3 // rows scrolled per notch of the wheel
 
 static uint16_t mouse_struct = 0xFF50;
 static uint16_t mouse_data = 0xFE60; // to 0xFEC3, since 100 bytes are needed for mouse pointer data
@@ -75,6 +77,7 @@ static bool LeftBtnPressed(int16_t x, int16_t y)
     uint16_t c = x/font_width();
     panel_t * popup = get_popup();
     popup_type_t panel_type = get_popup_type();
+    FinishGlide(); // the click lands on the rows where the scroll was going
     if (popup != NULL) { // did we press a popup button?
         if (panel_type == MSGDIALOG) {
             void * msg_dlg = popup;
@@ -90,11 +93,15 @@ static bool LeftBtnPressed(int16_t x, int16_t y)
         }
     } else if (r == 0) { // did we press a Main menu button?
         retval = IsMainMenuButtonPressed(r, c);
+    } else if (ScrollbarPressed(r, c)) { // jumped to where it was pressed
+        UpdateStatusBarPos();
+        retval = true;
     } else if (r < canvas_rows()-1) { // not in status bar
         left_button_pressed = true;
+        ActivatePaneAt(r);
         // move the cursor to the current mouse position
-        TheDoc.cursor_r = (r - TheTextbox.r) + TheDoc.offset_r;
-        TheDoc.cursor_c = (c - TheTextbox.c);
+        TheDoc.cursor_r = DocRowAt(r);
+        TheDoc.cursor_c = DocColAt(r, c);
         StartMarkingText();
         UpdateCursor();
         UpdateStatusBarPos();
@@ -172,14 +179,12 @@ static void MouseMoved(int16_t x, int16_t y)
          // need to find any button with focus and de-focus it
         RemoveFocusFromAllPanelButtons(&TheMainMenu);
         if (left_button_pressed &&
-            MarkingText((r - TheTextbox.r) + TheDoc.offset_r,
-                        (c - TheTextbox.c))) {
+            MarkingText(DocRowAt(r), DocColAt(r, c))) {
             // move the cursor to the current mouse position
-            TheDoc.cursor_r = (r - TheTextbox.r) + TheDoc.offset_r;
-            TheDoc.cursor_c = (c - TheTextbox.c);
+            TheDoc.cursor_r = DocRowAt(r);
+            TheDoc.cursor_c = DocColAt(r, c);
             UpdateCursor();
-            MarkText();
-            SetAllTextboxRowsDirty();
+            MarkText(); // sets dirty only what the drag changed
             UpdateStatusBarPos();
         }
     }
@@ -190,7 +195,7 @@ static void MouseMoved(int16_t x, int16_t y)
 bool HandleMouse(void)
 {
     static int sx, sy;
-    static uint8_t mb, mx, my;
+    static uint8_t mb, mx, my, mw;
     int16_t x, y;
     uint8_t rw, changed, pressed, released;
     bool xchg = false;
@@ -225,6 +230,22 @@ bool HandleMouse(void)
             sy = (canvas_height() - 2) * MOUSE_DIV;
     }
 
+    // read the wheel, a counter of notches turned
+    RIA.addr0 = mouse_state + 3;
+    rw = RIA.rw0;
+    if (mw != rw) {
+        int8_t notches = (int8_t)(rw - mw);
+        mw = rw;
+        if (!first_time && get_popup() == NULL) { // wheel towards you scrolls down
+            if (HexView()) {
+                ScrollHexView(-(int16_t)notches * WHEEL_ROWS);
+            } else {
+                GlideTextbox(-(int16_t)notches * WHEEL_ROWS);
+            }
+            UpdateStatusBarPos();
+        }
+    }
+
     // update mouse pointer on screen
     x = sx / MOUSE_DIV;
     y = sy / MOUSE_DIV;
@@ -45,7 +45,7 @@ msg_dlg_t * NewMsgDlg(char * msg, msg_dlg_type_t type,
             pmsg_dlg->panel.btn_addr[i] = NULL;
             pmsg_dlg->panel.action[i] = NULL;
         }
-        pmsg_dlg->panel.pstash = NULL;
+        pmsg_dlg->panel.shown = false;
 
         len_btns = 0;
         if (pmsg_dlg->msg_dlg_type == OK) {
@@ -96,33 +96,24 @@ msg_dlg_t * NewMsgDlg(char * msg, msg_dlg_type_t type,
 bool ShowMsgDlg(msg_dlg_t * pmsg_dlg, uint8_t row, uint8_t col)
 {
     if (pmsg_dlg != NULL) {
-        if (pmsg_dlg->panel.pstash == NULL &&
+        if (!pmsg_dlg->panel.shown &&
             row + pmsg_dlg->panel.h < canvas_rows() &&
             col + pmsg_dlg->panel.w < canvas_cols()   ) {
-            uint16_t bytes;
             pmsg_dlg->panel.r = row;
             pmsg_dlg->panel.c = col;
-            // backup display covered by panel (4bpp takes 2 bytes each char)
-            bytes = pmsg_dlg->panel.w*pmsg_dlg->panel.h*2;
-            pmsg_dlg->panel.pstash = (uint8_t *)malloc(bytes);
-            if (pmsg_dlg->panel.pstash != NULL) {
-                int8_t i, r, c, start, len;
+            // draw on the overlay, so the display under it is left as is
+            if (OpenOverlay(pmsg_dlg->panel.r, pmsg_dlg->panel.c, pmsg_dlg->panel.w, pmsg_dlg->panel.h)) {
+                int8_t r, start, len;
                 bool succeeded = false;
-                memset(pmsg_dlg->panel.pstash, 0, pmsg_dlg->panel.w*pmsg_dlg->panel.h*2);
-                BackupChars(pmsg_dlg->panel.r, pmsg_dlg->panel.c, pmsg_dlg->panel.w, pmsg_dlg->panel.h, pmsg_dlg->panel.pstash);
+                pmsg_dlg->panel.shown = true;
                 // draw panel background
                 for (r = pmsg_dlg->panel.r; r < pmsg_dlg->panel.r + pmsg_dlg->panel.h; r++) {
-                    for (c = pmsg_dlg->panel.c; c < pmsg_dlg->panel.c + pmsg_dlg->panel.w; c++) {
-                        DrawChar(r, c, ' ', pmsg_dlg->panel.bg, pmsg_dlg->panel.fg);
-                    }
+                    FillSpan(r, pmsg_dlg->panel.c, ' ', pmsg_dlg->panel.w, pmsg_dlg->panel.bg, pmsg_dlg->panel.fg);
                 }
                 // draw the dialog message
                 len  = strlen(pmsg_dlg->dlg_msg);
                 start = pmsg_dlg->panel.c + (pmsg_dlg->panel.w - len)/2;
-                i = 0;
-                for (c = start; c < (start + len); c++) {
-                    DrawChar(pmsg_dlg->panel.r + 1, c, pmsg_dlg->dlg_msg[i++], pmsg_dlg->panel.bg, pmsg_dlg->panel.fg);
-                }
+                DrawSpan(pmsg_dlg->panel.r + 1, start, pmsg_dlg->dlg_msg, len, pmsg_dlg->panel.bg, pmsg_dlg->panel.fg);
                 // show the buttons
                 if (pmsg_dlg->msg_dlg_type == OK) {
                     if (pmsg_dlg->panel.btn_addr[0] != NULL) {
@@ -160,7 +151,7 @@ bool ShowMsgDlg(msg_dlg_t * pmsg_dlg, uint8_t row, uint8_t col)
                 if (succeeded){
                     return true;
                 }
-            } // stash allocation failed
+            } // too big for overlay
             return false;
         }
     } // bad parameters
@@ -174,12 +165,7 @@ void DeleteMsgDlg(msg_dlg_t * pmsg_dlg)
     if (pmsg_dlg != NULL) {
         uint8_t i;
 
-        if (pmsg_dlg->panel.pstash != NULL) {
-            RestoreChars(pmsg_dlg->panel.r, pmsg_dlg->panel.c, pmsg_dlg->panel.w, pmsg_dlg->panel.h, pmsg_dlg->panel.pstash);
-
-            free(pmsg_dlg->panel.pstash);
-            pmsg_dlg->panel.pstash = NULL;
-        }
+        pmsg_dlg->panel.shown = false;
         for (i = 0; i < pmsg_dlg->panel.num_btns; i++) {
             button_t * btn = pmsg_dlg->panel.btn_addr[i];
             if (btn != NULL){
@@ -187,7 +173,7 @@ void DeleteMsgDlg(msg_dlg_t * pmsg_dlg)
                 pmsg_dlg->panel.btn_addr[i] = NULL;
             }
         }
-        set_popup(NULL);
+        set_popup(NULL); // closes the overlay
         set_popup_type(NO_POPUP_TYPE);
 
         free(pmsg_dlg);
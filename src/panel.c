@@ -36,7 +36,8 @@ panel_t * NewPanel(popup_type_t type, panel_btn_layout_t button_layout,
             panel->btn_addr[i] = NULL;
             panel->action[i] = NULL;
         }
-        panel->pstash = NULL;
+        panel->shown = false;
+        panel->image = NO_PANEL_IMAGE;
     }
     return panel;
 }
@@ -64,43 +65,78 @@ bool AddButtonToPanel(panel_t * panel, const char *label, int8_t alt_index,
 }
 
 // ---------------------------------------------------------------------------
+// Draws the panel's background and buttons, at its r, c
 // ---------------------------------------------------------------------------
-bool ShowPanel(panel_t * panel, uint8_t row, uint8_t col)
+static void DrawPanel(panel_t * panel)
+{
+    uint8_t i, r, start;
+
+    // draw panel background
+    for (r = panel->r; r < panel->r + panel->h; r++) {
+        FillSpan(r, panel->c, ' ', panel->w, panel->bg, panel->fg);
+    }
+
+    // draw the panel buttons, assuming panel is horizontal or vertical menu
+    start = 0;
+    for (i = 0; i < panel->num_btns; i++) {
+        if (panel->btn_layout == VERT) {
+            ShowButton(panel->btn_addr[i], panel->r+i, panel->c);
+        } else {
+            ShowButton(panel->btn_addr[i], panel->r, panel->c + start);
+            start += panel->btn_addr[i]->w;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Draws the panel, as it will show at row, col, into an overlay canvas in
+// XRAM at image, w*h*2 bytes, once. Showing it is then just pointing the
+// overlay at image, and focus changes patch only their button rows in it.
+// The panel is kept when closed, to be shown again.
+// ---------------------------------------------------------------------------
+bool PrerenderPanel(panel_t * panel, uint16_t image, uint8_t row, uint8_t col)
 {
     if (panel != NULL) {
-        uint8_t i, r, c, start;
-        if (panel->pstash == NULL &&
+        if (!panel->shown &&
             row + panel->h <= canvas_rows() &&
             col + panel->w <= canvas_cols()   ) {
-
             panel->r = row;
             panel->c = col;
+            panel->image = image;
+            SetOverlay(panel->image, panel->r, panel->c, panel->w, panel->h);
+            DrawPanel(panel);
+            CloseOverlay();
+            return true;
+        }
+    } // bad parameters
+    return false;
+}
 
-            // backup display covered by panel (4bpp takes 2 bytes each char)
-            panel->pstash = (uint8_t *)malloc(panel->w*panel->h*2);
-            if (panel->pstash != NULL) {
-                memset(panel->pstash, 0, panel->w*panel->h*2);
-                BackupChars(panel->r, panel->c, panel->w, panel->h, panel->pstash);
+// ---------------------------------------------------------------------------
+// Shows the panel on the overlay, so the display under it is left as is.
+// Prerendered panels show where they were rendered, ignoring row, col.
+// ---------------------------------------------------------------------------
+bool ShowPanel(panel_t * panel, uint8_t row, uint8_t col)
+{
+    if (panel != NULL) {
+        if (!panel->shown && panel->image != NO_PANEL_IMAGE) {
+            SetOverlay(panel->image, panel->r, panel->c, panel->w, panel->h);
+            ShowOverlay();
+            panel->shown = true;
+            return true;
+        }
+        if (!panel->shown &&
+            row + panel->h <= canvas_rows() &&
+            col + panel->w <= canvas_cols()   ) {
 
-                // draw panel background
-                for (r = panel->r; r < panel->r + panel->h; r++) {
-                    for (c = panel->c; c < panel->c + panel->w; c++) {
-                        DrawChar(r, c, ' ', panel->bg, panel->fg);
-                    }
-                }
+            panel->r = row;
+            panel->c = col;
 
-                // draw the panel buttons, assuming panel is horizontal or vertical menu
-                start = 0;
-                for (i = 0; i < panel->num_btns; i++) {
-                    if (panel->btn_layout == VERT) {
-                        ShowButton(panel->btn_addr[i], panel->r+i, panel->c);
-                    } else {
-                        ShowButton(panel->btn_addr[i], panel->r, panel->c + start);
-                        start += panel->btn_addr[i]->w;
-                    }
-                }
+            if (OpenOverlay(panel->r, panel->c, panel->w, panel->h)) {
+                panel->shown = true;
+                DrawPanel(panel);
                 return true;
-            } // stash allocation failed
+            } // too big for overlay
             return false;
         }
     } // bad parameters
@@ -114,23 +150,22 @@ void DeletePanel(panel_t * panel)
     if (panel != NULL) {
         uint8_t i;
 
-        if (panel->pstash != NULL) {
-            RestoreChars(panel->r, panel->c, panel->w, panel->h, panel->pstash);
-
-            for (i = 0; i < panel->num_btns; i++) {
-                button_t * btn = panel->btn_addr[i];
-                if (btn != NULL){
-                    free(btn);
-                    panel->btn_addr[i] = NULL;
-                }
-            }
-            free(panel->pstash);
-            panel->pstash = NULL;
+        if (panel->shown) {
+            panel->shown = false;
 
-            set_popup(NULL);
+            set_popup(NULL); // closes the overlay
             set_popup_type(NO_POPUP_TYPE);
 
-            free(panel);
+            if (panel->image == NO_PANEL_IMAGE) { // prerendered ones are kept
+                for (i = 0; i < panel->num_btns; i++) {
+                    button_t * btn = panel->btn_addr[i];
+                    if (btn != NULL){
+                        free(btn);
+                        panel->btn_addr[i] = NULL;
+                    }
+                }
+                free(panel);
+            }
 
             UpdateTextboxFocus(true);
 
@@ -14,6 +14,7 @@ typedef enum {HORZ, VERT} panel_btn_layout_t;
 typedef void (*panel_btn_action)(void);
 
 #define MAX_PANEL_BTNS 5
+#define NO_PANEL_IMAGE 0xFFFF // drawn each time it's shown, and freed on delete
 
 typedef struct panel {
     popup_type_t panel_type;
@@ -27,7 +28,8 @@ typedef struct panel {
     uint8_t num_btns;
     button_t * btn_addr[MAX_PANEL_BTNS];
     panel_btn_action action[MAX_PANEL_BTNS];
-    uint8_t * pstash; // mem allocated and used to save & restore chars covered by popup panel
+    bool shown; // drawn on the display's overlay
+    uint16_t image; // XRAM of its prerendered overlay cells, or NO_PANEL_IMAGE
 } panel_t;
 
 panel_t * NewPanel(popup_type_t type, panel_btn_layout_t button_layout,
@@ -39,6 +41,7 @@ bool AddButtonToPanel(panel_t * panel, const char *label, int8_t alt_index,
                       uint8_t focus_bg_color, uint8_t focus_fg_color,
                       uint8_t alt_fg_color, panel_btn_action action);
 
+bool PrerenderPanel(panel_t * panel, uint16_t image, uint8_t row, uint8_t col);
 bool ShowPanel(panel_t * panel, uint8_t row, uint8_t col);
 void DeletePanel(panel_t * panel);
 
@@ -12,11 +12,24 @@
 #include "colors.h"
 #include "display.h"
 #include "textbox.h"
+#include "hex.h"
 #include "statusbar.h"
 
-#define MAX_CUR_POS 18
+// The status bar is split into segments, each drawn by DrawSegment, which
+// keeps a copy of the segment's chars as shown and only redraws the cells
+// that change. Cols 0, 61 and 79 are always blank.
+#define MSG_COL 1 // to 60, MAX_STATUS_MSG chars
+#define FLAGS_COL 62 // '*' if the doc is dirty, then 'I' if auto indent is on
+#define FLAGS_W 2
+#define POS_COL 64 // "Line 672 Col 81", or "Offset 0001A2F0" in hex view
+#define POS_W 15
+#define LINE_FIELD 5 // the numbers are right aligned, so they never move
+#define LINE_FIELD_W 3
+#define COL_FIELD 13
+#define COL_FIELD_W 2
+#define HEX_POS 0x8000 // pos_line's flag for an offset shown
 
-static uint16_t row = 29;
+static uint16_t row = 29; // canvas_rows()-1, the display's last row
 static uint16_t col = 0;
 static uint8_t w = 80;
 static uint8_t h = 1;
@@ -27,7 +40,15 @@ static uint8_t fg_warning = YELLOW;
 static uint8_t fg_error = RED;
 
 static char msg[MAX_STATUS_MSG+1] = {0};
-static char pos[MAX_CUR_POS+1] = {0};
+static uint8_t msg_fg = LIGHT_GRAY;
+
+// segments as shown, 0 for cells to be redrawn
+static char msg_shown[MAX_STATUS_MSG];
+static char flags_shown[FLAGS_W];
+static char pos_shown[POS_W];
+static char pos[POS_W+1] = {0}; // to be shown, kept to step its numbers
+static uint16_t pos_line = 0; // in pos, 0 if none
+static uint16_t pos_column = 0;
 
 #define wait(duration) (duration)
 #define trumpet(note, duration) (-1), (note), (duration)
@@ -145,23 +166,95 @@ void ReportFileError(void)
 }
 
 // ---------------------------------------------------------------------------
+// Draws text, padded with spaces to w cells, from column c of the status
+// bar, writing only the cells that differ from shown, which is then updated
 // ---------------------------------------------------------------------------
-void InitStatusBar(void)
+static void DrawSegment(char * shown, uint8_t c, uint8_t w, const char * text, uint8_t fg_clr)
 {
-    uint8_t c;
-    // draw status bar background
-    for (c = 0; c < w; c++) {
-        DrawChar(row, col, ' ', bg, fg);
+    uint8_t i;
+    for (i = 0; i < w; i++) {
+        char ch = (*text != 0) ? *(text++) : ' ';
+        if (shown[i] != ch) {
+            DrawChar(row, c + i, ch, bg, fg_clr);
+            shown[i] = ch;
+        }
     }
-    UpdateStatusBarMsg("Welcome to TE, a text editor for the RP6502", STATUS_INFO);
+}
+
+// ---------------------------------------------------------------------------
+// Writes n in decimal, right aligned in the w chars from p
+// ---------------------------------------------------------------------------
+static void PutField(char * p, uint8_t w, uint16_t n)
+{
+    uint8_t i = w;
+    do {
+        p[--i] = '0' + n % 10;
+        n /= 10;
+    } while (n > 0 && i > 0);
+    while (i > 0) {
+        p[--i] = ' ';
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Changes the w char field from p, showing from, to show to. A step of one
+// up or down changes the last digit, and any carried or borrowed into,
+// without dividing; anything else is written afresh.
+// ---------------------------------------------------------------------------
+static void StepField(char * p, uint8_t w, uint16_t from, uint16_t to)
+{
+    uint8_t i = w;
+    if (to == from+1) {
+        while (i > 0) {
+            i--;
+            if (p[i] != '9') {
+                p[i] = (p[i] == ' ') ? '1' : p[i]+1;
+                return;
+            }
+            p[i] = '0';
+        }
+    } else if (to+1 == from) {
+        while (i > 0) {
+            i--;
+            if (p[i] != '0') { // a leading 1 becomes a blank
+                p[i] = (p[i] == '1' && i+1 < w && (i == 0 || p[i-1] == ' ')) ? ' ' : p[i]-1;
+                return;
+            }
+            p[i] = '9';
+        }
+    } else {
+        PutField(p, w, to);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Draws the status bar background and all its segments afresh
+// ---------------------------------------------------------------------------
+static void DrawStatusBar(void)
+{
+    FillSpan(row, col, ' ', w, bg, fg);
+    memset(msg_shown, ' ', MAX_STATUS_MSG);
+    memset(flags_shown, ' ', FLAGS_W);
+    memset(pos_shown, ' ', POS_W);
+    pos_line = 0;
+    DrawSegment(msg_shown, MSG_COL, MAX_STATUS_MSG, msg, msg_fg);
+    UpdateStatusBarFlags();
     UpdateStatusBarPos();
 }
 
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void InitStatusBar(void)
+{
+    row = canvas_rows()-1;
+    DrawStatusBar();
+    UpdateStatusBarMsg("Welcome to TE, a text editor for the RP6502", STATUS_INFO);
+}
+
 // ---------------------------------------------------------------------------
 // ---------------------------------------------------------------------------
 void UpdateStatusBarMsg(const char * status_msg, status_level_t level)
 {
-    uint8_t c;
     uint8_t fg_clr = fg_info;
     uint8_t msg_len = 0;
 
@@ -184,12 +277,11 @@ void UpdateStatusBarMsg(const char * status_msg, status_level_t level)
         strncpy(msg, status_msg, MAX_STATUS_MSG);
         msg_len = strlen(msg);
     }
-    for (c = 0; c <= MAX_STATUS_MSG; c++) {
-        DrawChar(row, c, ' ', bg, bg);
-    }
-    for (c = 0; c < msg_len; c++) {
-        DrawChar(row, c+1, msg[c], bg, fg_clr);
+    if (fg_clr != msg_fg) { // all of the msg is redrawn in its new color
+        memset(msg_shown, 0, MAX_STATUS_MSG);
+        msg_fg = fg_clr;
     }
+    DrawSegment(msg_shown, MSG_COL, MAX_STATUS_MSG, msg, msg_fg);
     if (msg_len > 0) {
         switch((uint8_t)level) {
             case STATUS_INFO:
@@ -206,25 +298,67 @@ void UpdateStatusBarMsg(const char * status_msg, status_level_t level)
 }
 
 // ---------------------------------------------------------------------------
+// Shows the cursor position, if it moved. The line and column are kept
+// right aligned in fixed fields, and a move of a column or a line steps
+// a digit or two of them, so only those cells are drawn. In hex view
+// it's the cursor's offset in the file, kept as line and column too, with
+// the line's HEX_POS flag set.
 // ---------------------------------------------------------------------------
 void UpdateStatusBarPos(void)
 {
-    uint8_t c, start;
-
     // add extra +1 to line, column, so we have 1,1 at start of doc
     uint16_t line = 1 + TheDoc.cursor_r;
     uint16_t column = 1 + TheDoc.cursor_c;
+    uint32_t offset = HexCursor();
+    int8_t i;
 
-    snprintf(pos, MAX_CUR_POS, "Line %u Col %u ", line, column);
-
-    start = w-MAX_CUR_POS-1;
-    for (c = 0; c < MAX_CUR_POS; c++) {
-        DrawChar(row, start+c, ' ', bg, fg);
+    if (HexView()) {
+        line = HEX_POS | (uint16_t)(offset >> 16);
+        column = (uint16_t)offset;
     }
-    start = w-1-strlen(pos);
-    for (c = 0; c < strlen(pos); c++) {
-        DrawChar(row, start+c, pos[c], bg, fg);
+    if (line == pos_line && column == pos_column) {
+        return;
     }
+    if (HexView()) {
+        memcpy(pos, "Offset ", 7);
+        for (i = 7; i >= 0; i--) {
+            pos[7 + i] = "0123456789ABCDEF"[offset & 0xF];
+            offset >>= 4;
+        }
+    } else if (pos_line == 0 || (pos_line & HEX_POS) != 0) {
+        memcpy(pos, "Line     Col   ", POS_W);
+        PutField(pos + LINE_FIELD, LINE_FIELD_W, line);
+        PutField(pos + COL_FIELD, COL_FIELD_W, column);
+    } else {
+        StepField(pos + LINE_FIELD, LINE_FIELD_W, pos_line, line);
+        StepField(pos + COL_FIELD, COL_FIELD_W, pos_column, column);
+    }
+    pos_line = line;
+    pos_column = column;
+    DrawSegment(pos_shown, POS_COL, POS_W, pos, fg);
+}
+
+// ---------------------------------------------------------------------------
+// Shows the doc's dirty flag and auto indent mode. Called every frame, and
+// only draws when one changed.
+// ---------------------------------------------------------------------------
+void UpdateStatusBarFlags(void)
+{
+    char flags[FLAGS_W+1];
+    flags[0] = TheDoc.dirty ? '*' : ' ';
+    flags[1] = TheDoc.auto_indent ? 'I' : ' ';
+    flags[2] = 0;
+    DrawSegment(flags_shown, FLAGS_COL, FLAGS_W, flags, fg);
+}
+
+// ---------------------------------------------------------------------------
+// Draws the status bar again, quietly, on the display's last row, after
+// the display's rows changed
+// ---------------------------------------------------------------------------
+void RedrawStatusBar(void)
+{
+    row = canvas_rows()-1;
+    DrawStatusBar();
 }
 
 // ---------------------------------------------------------------------------
@@ -15,6 +15,8 @@ typedef enum {STATUS_INFO, STATUS_WARNING, STATUS_ERROR} status_level_t;
 void InitStatusBar(void);
 void UpdateStatusBarMsg(const char * status_msg, status_level_t level);
 void UpdateStatusBarPos(void);
+void UpdateStatusBarFlags(void);
+void RedrawStatusBar(void);
 void ReportFileError(void);
 
 void incr_status_timer(void);
@@ -0,0 +1,343 @@
+// ---------------------------------------------------------------------------
+// syntax.c
+// ---------------------------------------------------------------------------
+
+#include <rp6502.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "colors.h"
+#include "doc.h"
+#include "display.h"
+#include "textbox.h"
+#include "syntax.h"
+
+#define is_digit(ch) ((ch) >= '0' && (ch) <= '9')
+#define is_alpha(ch) (((ch) >= 'a' && (ch) <= 'z') || ((ch) >= 'A' && (ch) <= 'Z') || (ch) == '_')
+#define is_word(ch) (is_alpha(ch) || is_digit(ch) || (ch) == '.' || (ch) == '$' || (ch) == '%' || (ch) == '@')
+
+#define LEX_ROWS_PER_FRAME 32 // rows re-lexed per frame, at most
+
+static const uint8_t clr_comment = DARK_CYAN;
+static const uint8_t clr_string = YELLOW;
+static const uint8_t clr_number = MAGENTA;
+static const uint8_t clr_keyword = CYAN;
+static const uint8_t clr_directive = BROWN; // C preprocessor and asm directives
+static const uint8_t clr_label = WHITE;
+
+static const char * const c_keywords[] = {
+    "auto", "break", "case", "char", "const", "continue", "default", "do",
+    "double", "else", "enum", "extern", "float", "for", "goto", "if",
+    "inline", "int", "long", "register", "return", "short", "signed",
+    "sizeof", "static", "struct", "switch", "typedef", "union", "unsigned",
+    "void", "volatile", "while", "bool", "true", "false", "NULL",
+    "int8_t", "int16_t", "int32_t", "uint8_t", "uint16_t", "uint32_t", NULL
+};
+
+// 65C02 mnemonics, three chars each
+static const char mnemonics[] =
+    "adcandaslbbrbbsbccbcsbeqbitbmibnebplbrabrkbvcbvsclccldcliclvcmpcpx"
+    "cpydecdexdeyeorincinxinyjmpjsrldaldxldylsrnoporaphaphpphxphyplaplp"
+    "plxplyrmbrolrorrtirtssbcsecsedseismbstastpstxstystztaxtaytrbtsbtsx"
+    "txatxstyawai";
+
+static uint8_t start_state = LEX_PLAIN; // of row 0, for the doc's language
+
+// ---------------------------------------------------------------------------
+// Colors cells s to e-1 clr, unless only the end state is wanted
+// ---------------------------------------------------------------------------
+static void Paint(uint8_t * fg, uint8_t s, uint8_t e, uint8_t clr)
+{
+    if (fg != NULL) {
+        memset(fg + s, clr, e - s);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Returns the index just past the run of word chars starting at c
+// ---------------------------------------------------------------------------
+static uint8_t EndOfWord(const char * row, uint8_t len, uint8_t c)
+{
+    while (c < len && is_word(row[c])) {
+        c++;
+    }
+    return c;
+}
+
+// ---------------------------------------------------------------------------
+// Returns the index just past the quote closing the string or char
+// constant at c, or len if it isn't closed on this row
+// ---------------------------------------------------------------------------
+static uint8_t EndOfString(const char * row, uint8_t len, uint8_t c, char quote)
+{
+    while (c < len) {
+        if (row[c] == '\\') {
+            c += 2;
+        } else if (row[c++] == quote) {
+            return c;
+        }
+    }
+    return len;
+}
+
+// ---------------------------------------------------------------------------
+// Checks the first char before comparing, so most words cost one compare
+// ---------------------------------------------------------------------------
+static bool IsKeyword(const char * word, uint8_t n)
+{
+    const char * const * kw;
+    for (kw = c_keywords; *kw != NULL; kw++) {
+        if ((*kw)[0] == word[0] && strlen(*kw) == n && strncmp(*kw, word, n) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+static bool IsMnemonic(const char * word, uint8_t n)
+{
+    const char * m;
+    if (n == 3) {
+        char a = word[0] | 0x20; // lower case
+        char b = word[1] | 0x20;
+        char c = word[2] | 0x20;
+        for (m = mnemonics; *m != 0; m += 3) {
+            if (m[0] == a && m[1] == b && m[2] == c) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Lexes a row of C, from state, coloring it into fg if not NULL
+// ---------------------------------------------------------------------------
+static uint8_t LexC(const char * row, uint8_t len, uint8_t state, uint8_t * fg)
+{
+    uint8_t c = 0;
+    uint8_t e;
+    uint8_t first = 0; // first non-blank char, where '#' starts a directive
+    while (first < len && (row[first] == ' ' || row[first] == '\t')) {
+        first++;
+    }
+    if (state == LEX_C_STRING) { // string continued from the row above
+        e = EndOfString(row, len, 0, '"');
+        Paint(fg, 0, e, clr_string);
+        state = (e == len && len > 0 && row[len-1] == '\\') ? LEX_C_STRING : LEX_C;
+        c = e;
+    }
+    while (c < len) {
+        char ch = row[c];
+        char next = (c+1 < len) ? row[c+1] : 0;
+        if (state == LEX_C_COMMENT) {
+            for (e = c; e < len && !(row[e] == '*' && e+1 < len && row[e+1] == '/'); e++) {
+                ;
+            }
+            if (e < len) {
+                e += 2;
+                state = LEX_C;
+            }
+            Paint(fg, c, e, clr_comment);
+        } else if (ch == '/' && next == '*') {
+            e = c + 2;
+            state = LEX_C_COMMENT;
+            Paint(fg, c, e, clr_comment);
+        } else if (ch == '/' && next == '/') {
+            e = len;
+            Paint(fg, c, e, clr_comment);
+        } else if (ch == '"' || ch == '\'') {
+            e = EndOfString(row, len, c+1, ch);
+            if (ch == '"' && e == len && row[len-1] == '\\') {
+                state = LEX_C_STRING;
+            }
+            Paint(fg, c, e, clr_string);
+        } else if (ch == '#' && c == first) {
+            e = EndOfWord(row, len, c+1);
+            Paint(fg, c, e, clr_directive);
+        } else if (is_digit(ch)) {
+            e = EndOfWord(row, len, c);
+            Paint(fg, c, e, clr_number);
+        } else if (is_alpha(ch)) {
+            e = EndOfWord(row, len, c);
+            if (IsKeyword(row + c, e - c)) {
+                Paint(fg, c, e, clr_keyword);
+            }
+        } else {
+            e = c + 1;
+        }
+        c = e;
+    }
+    return state;
+}
+
+// ---------------------------------------------------------------------------
+// Lexes a row of ca65 or llvm-mos assembly, coloring it into fg if not NULL
+// ---------------------------------------------------------------------------
+static uint8_t LexAsm(const char * row, uint8_t len, uint8_t * fg)
+{
+    uint8_t c = 0;
+    uint8_t e;
+    while (c < len) {
+        char ch = row[c];
+        if (ch == ';') {
+            e = len;
+            Paint(fg, c, e, clr_comment);
+        } else if (ch == '"' || ch == '\'') {
+            e = EndOfString(row, len, c+1, ch);
+            Paint(fg, c, e, clr_string);
+        } else if (is_digit(ch) || ch == '$' || ch == '%') {
+            e = EndOfWord(row, len, c+1);
+            Paint(fg, c, e, clr_number);
+        } else if (ch == '.') {
+            e = EndOfWord(row, len, c+1);
+            Paint(fg, c, e, clr_directive);
+        } else if (is_alpha(ch) || ch == '@') {
+            e = EndOfWord(row, len, c+1);
+            if (e < len && row[e] == ':') {
+                e++;
+                Paint(fg, c, e, clr_label);
+            } else if (IsMnemonic(row + c, e - c)) {
+                Paint(fg, c, e, clr_keyword);
+            }
+        } else {
+            e = c + 1;
+        }
+        c = e;
+    }
+    return LEX_ASM;
+}
+
+// ---------------------------------------------------------------------------
+// Lexes a row, starting in state, and returns the state at its end.
+// If fg isn't NULL, the highlighted cells' colors are written to it, and
+// the rest are left as they are. One pass, with no backtracking, so
+// coloring costs about the same per cell as drawing does.
+// ---------------------------------------------------------------------------
+uint8_t LexRow(const char * row, uint8_t len, uint8_t state, uint8_t * fg)
+{
+    if (state >= LEX_ASM) {
+        return LexAsm(row, len, fg);
+    } else if (state >= LEX_C) {
+        return LexC(row, len, state, fg);
+    }
+    return state;
+}
+
+// ---------------------------------------------------------------------------
+// Picks the doc's language from its filename's extension, and has every
+// row re-lexed. The textbox is redrawn if the language changed.
+// ---------------------------------------------------------------------------
+void InitSyntax(void)
+{
+    uint8_t state = LEX_PLAIN;
+    const char * dot = strrchr(TheDoc.filename, '.');
+    if (dot != NULL && strlen(dot) <= 4) {
+        char ext[5];
+        uint8_t i;
+        for (i = 0; i < 5; i++) {
+            ext[i] = (dot[i] >= 'A' && dot[i] <= 'Z') ? dot[i] | 0x20 : dot[i];
+        }
+        if (strcmp(ext, ".c") == 0 || strcmp(ext, ".h") == 0) {
+            state = LEX_C;
+        } else if (strcmp(ext, ".s") == 0 || strcmp(ext, ".asm") == 0 ||
+                   strcmp(ext, ".inc") == 0 || strcmp(ext, ".a65") == 0) {
+            state = LEX_ASM;
+        }
+    }
+    if (state != start_state) {
+        start_state = state;
+        LexRowsChanged(0, TheDoc.last_row);
+        SetAllTextboxRowsDirty();
+    }
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+bool SyntaxActive(void)
+{
+    return start_state != LEX_PLAIN;
+}
+
+// ---------------------------------------------------------------------------
+// Re-lexes the rows above R whose cached end states may be stale, from the
+// first changed row on, until past the last changed row an end state comes
+// out unchanged. Rows whose start state changed are set dirty, as their
+// colors change. At most LEX_ROWS_PER_FRAME rows are lexed per call, once
+// a frame, and the next call carries on from there.
+// ---------------------------------------------------------------------------
+void RelexRows(uint16_t R)
+{
+    char row[DOC_COLS];
+    uint8_t n = 0;
+    if (start_state == LEX_PLAIN) {
+        return;
+    }
+    if (R > TheDoc.last_row+1) {
+        R = TheDoc.last_row+1;
+    }
+    while (TheDoc.lex_from < R && n < LEX_ROWS_PER_FRAME) {
+        uint16_t k = TheDoc.lex_from;
+        uint8_t state = (k > 0) ? TheDoc.rows[k-1].lex : start_state;
+        uint8_t len = TheDoc.rows[k].len;
+        ReadStr(TheDoc.rows[k].ptxt, row, len);
+        state = LexRow(row, len, state, NULL);
+        if (state != TheDoc.rows[k].lex) {
+            TheDoc.rows[k].lex = state;
+            SetDocSpanDirty(k+1, 0, DOC_COLS-1);
+            if (k >= TheDoc.lex_to) {
+                TheDoc.lex_to = k+1;
+            }
+        }
+        if (k >= TheDoc.lex_to || k >= TheDoc.last_row) {
+            TheDoc.lex_from = NO_LEX_ROW; // converged
+            TheDoc.lex_to = 0;
+        } else {
+            TheDoc.lex_from = k+1;
+        }
+        n++;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Returns true if the state at the start of row R is known, so the rows
+// above it needn't be re-lexed first
+// ---------------------------------------------------------------------------
+bool SyntaxKnown(uint16_t R)
+{
+    if (R > TheDoc.last_row+1) {
+        R = TheDoc.last_row+1;
+    }
+    return R == 0 || start_state == LEX_PLAIN || TheDoc.lex_from >= R;
+}
+
+// ---------------------------------------------------------------------------
+// Returns the lexer state at the start of row R, as cached. Until RelexRows
+// has got past the rows above it, it may be stale, and the row is set dirty
+// again if it turns out to be.
+// ---------------------------------------------------------------------------
+uint8_t SyntaxStartState(uint16_t R)
+{
+    if (R == 0 || start_state == LEX_PLAIN) {
+        return start_state;
+    }
+    if (R > TheDoc.last_row+1) {
+        R = TheDoc.last_row+1;
+    }
+    return TheDoc.rows[R-1].lex;
+}
+
+// ---------------------------------------------------------------------------
+// Returns where the coloring of cells from c on may start to change when
+// they're edited: the start of the word c is in, less one for the two-char
+// tokens like "//"
+// ---------------------------------------------------------------------------
+uint8_t SyntaxTokenStart(const char * row, uint8_t c)
+{
+    while (c > 0 && is_word(row[c-1])) {
+        c--;
+    }
+    return (c > 0) ? c-1 : 0;
+}
@@ -0,0 +1,27 @@
+// ---------------------------------------------------------------------------
+// syntax.h
+// ---------------------------------------------------------------------------
+
+#ifndef SYNTAX_H
+#define SYNTAX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// lexer states, as cached at each row end in doc_row_t lex. Each language
+// has its own states, so a row's start state also says how it's colored.
+#define LEX_PLAIN 0 // no language, so no coloring
+#define LEX_C 1
+#define LEX_C_COMMENT 2 // inside a /* */ comment
+#define LEX_C_STRING 3 // inside a string continued with a trailing '\'
+#define LEX_ASM 4
+
+void InitSyntax(void);
+bool SyntaxActive(void);
+void RelexRows(uint16_t R);
+bool SyntaxKnown(uint16_t R);
+uint8_t SyntaxStartState(uint16_t R);
+uint8_t SyntaxTokenStart(const char * row, uint8_t c);
+uint8_t LexRow(const char * row, uint8_t len, uint8_t state, uint8_t * fg);
+
+#endif // SYNTAX_H
@@ -11,8 +11,22 @@
 #include "doc.h"
 #include "colors.h"
 #include "display.h"
+#include "syntax.h"
+#include "hex.h"
 #include "textbox.h"
 
+#define CURSOR_W 8 // cursor bar bitmap size, in pixels
+#define CURSOR_H 2
+
+// scrollbar cells, as kept in bar_cell
+#define BAR_TRACK 1
+#define BAR_THUMB 2
+#define BAR_MARK 4 // a bookmark is on the rows the cell stands for
+
+// shown after the text of a fold's first row
+#define FOLD_MARK "..."
+#define FOLD_MARK_W 3
+
 typedef enum {BLINK_ON, BLINK_OFF} cursor_state_t;
 typedef enum {UNMARKED, MARKING, MARKED} mark_state_t;
 typedef struct mark_pt {
@@ -20,19 +34,59 @@ typedef struct mark_pt {
     int16_t col;
 } mark_pt_t;
 
-textbox_t TheTextbox = {
+textbox_t ThePanes[NUM_PANES] = {{
     1,                  // r
     0,                  // c
-    DOC_ROWS_DISPLAYED, // h
-    80,                 // w
+    28,                 // h, canvas_rows()-2, less menu and status bar
+    79,                 // w, less the scrollbar
     BLACK,              // bg
     LIGHT_GRAY,         // fg
     true,               // in_focus
-    {false, false, false, false, false, false, false,
-     false, false, false, false, false, false, false,
-     false, false, false, false, false, false, false,
-     false, false, false, false, false, false, false} // row_dirty[28]
-};
+    0,                  // ring
+    0,                  // offset_r
+    0,                  // offset_s
+    0,                  // cursor_r
+    0,                  // cursor_c
+    {0},                // dirty_c0[58], all set dirty by InitTextbox
+    {0},                // dirty_c1[58]
+    {{0}},              // row_shown[58], NO_SIGNATURE
+    {0},                // gutter_num[58]
+    0,                  // bar_offset_r
+    0,                  // bar_last_row
+    NO_BAR_H,           // bar_h
+    {0},                // bar_marks[9]
+    {0},                // bar_cell[58], NO_BAR_CELL
+    {0},                // map_R[58], set by MapPane()
+    {0},                // map_s[58]
+    {0}                 // map_n[58]
+}, {
+    1,                  // r, set by SplitTextbox()
+    0,                  // c
+    0,                  // h, 0 until split
+    79,                 // w, less the scrollbar
+    BLACK,              // bg
+    LIGHT_GRAY,         // fg
+    true,               // in_focus
+    1,                  // ring
+    0,                  // offset_r
+    0,                  // offset_s
+    0,                  // cursor_r
+    0,                  // cursor_c
+    {0},                // dirty_c0[58]
+    {0},                // dirty_c1[58]
+    {{0}},              // row_shown[58], NO_SIGNATURE
+    {0},                // gutter_num[58]
+    0,                  // bar_offset_r
+    0,                  // bar_last_row
+    NO_BAR_H,           // bar_h
+    {0},                // bar_marks[9]
+    {0},                // bar_cell[58], NO_BAR_CELL
+    {0},                // map_R[58], set by MapPane()
+    {0},                // map_s[58]
+    {0}                 // map_n[58]
+}};
+
+textbox_t * TheTextbox = &ThePanes[0];
 
 char TheClipboard[CLIPBOARD_SIZE] = {0};
 
@@ -40,12 +94,31 @@ char TheClipboard[CLIPBOARD_SIZE] = {0};
 static cursor_state_t cur_state = BLINK_OFF;
 static uint8_t cur_c; // as drawn on display
 static uint8_t cur_r; // as drawn on display
+static bool cur_inverted = false; // cur_r, cur_c drawn inverted on the overlay
+static uint8_t cur_bg; // the inverted cell's own colors
+static uint8_t cur_fg;
 
 static const uint8_t cur_threshold = 30; // cursor blink delay = 1/2 second
-static const uint8_t update_threshold = 3; // redraw freq = 20x/second
+static const uint16_t cursor_struct = 0xFF70;
+static const uint16_t cursor_data = 0xFE40; // to 0xFE4F, CURSOR_W*CURSOR_H bytes
+static const uint8_t cursor_clr = 15; // bright white, in the 8-bit palette
+static const int16_t render_budget = 4*80; // dirty cells drawn per frame
+static const int16_t signature_cost = 16; // in cells, for checking a row
 
 static void * p_popup = NULL; //unless popup is overlapping display
 static uint8_t popuptype = 0; // INVALID
+static uint8_t num_panes = 1;
+static uint8_t bar_w = SCROLLBAR_W; // 0 if the scrollbar is hidden
+static bool soft_wrap = false; // if rows wider than the panes wrap onto more rows
+
+// smooth scrolling, of the active pane, a row at a time
+static bool smooth_scroll = false; // if paging and the mouse wheel glide
+static bool gliding = false;
+static uint16_t glide_to = 0; // offset_r being scrolled to
+static uint8_t glide_px = 0; // pixels left to scroll the current row in
+static int8_t glide_dir = 0; // +1 if the text moves up, -1 if down
+
+static void Glide(void);
 
 
 // mark_pt_t row, col in doc cursor coords
@@ -56,66 +129,306 @@ static uint16_t mark_min_r = 0;
 static uint16_t mark_min_c = 0;
 static uint16_t mark_max_r = 0;
 static uint16_t mark_max_c = 0;
+static bool mark_shown = false; // if the mark limits are highlighted
+static mark_pt_t mark_p = {0, 0}; // highlighted from mark_p up to mark_q
+static mark_pt_t mark_q = {0, 0};
+
+// ---------------------------------------------------------------------------
+// Returns the width rows are wrapped at in pane tb, which if not wrapping
+// is past the longest row, so every row is a single segment
+// ---------------------------------------------------------------------------
+static uint8_t WrapWidth(textbox_t * tb)
+{
+    return soft_wrap ? tb->w : DOC_COLS+1;
+}
+
+// ---------------------------------------------------------------------------
+// Returns how many display rows, or segments, doc row R is wrapped onto in
+// pane tb. Rows past the doc's last row are one empty segment.
+// ---------------------------------------------------------------------------
+static uint8_t RowSegments(textbox_t * tb, uint16_t R)
+{
+    uint8_t w = WrapWidth(tb);
+    uint8_t n = 1;
+    uint8_t c;
+    if (R <= TheDoc.last_row) {
+        for (c = w; c < TheDoc.rows[R].len; c += w) {
+            n++;
+        }
+    }
+    return n;
+}
+
+// ---------------------------------------------------------------------------
+// Returns the segment of doc row R that its col C is shown in
+// ---------------------------------------------------------------------------
+static uint8_t SegmentOf(textbox_t * tb, uint16_t R, uint16_t C)
+{
+    uint8_t s = C / WrapWidth(tb);
+    uint8_t n = RowSegments(tb, R);
+    return (s < n) ? s : n-1;
+}
+
+// ---------------------------------------------------------------------------
+// Steps doc row *pR, segment *ps on to the next segment shown, or back to
+// the one before, stopping at the doc's first. Folded rows are stepped over
+// in one go.
+// ---------------------------------------------------------------------------
+static void NextSegment(textbox_t * tb, uint16_t * pR, uint8_t * ps)
+{
+    if (++(*ps) >= RowSegments(tb, *pR)) {
+        *pR = FoldEnd(*pR) + 1;
+        *ps = 0;
+    }
+}
+static void PrevSegment(textbox_t * tb, uint16_t * pR, uint8_t * ps)
+{
+    if (*ps > 0) {
+        (*ps)--;
+    } else if (*pR > 0) {
+        *pR = FoldStart(*pR - 1);
+        *ps = RowSegments(tb, *pR)-1;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Maps the display rows of pane tb, from row r down, to the doc row and
+// segment each shows, the segment after the one above's, starting from
+// the pane's offset. Rows whose mapping changed are set dirty. Only the
+// rows from the first showing a doc row that was rewrapped, added or
+// deleted need remapping, so editing never walks more than a pane's rows.
+// Folded rows are skipped, as the doc row after a fold follows its first.
+// ---------------------------------------------------------------------------
+static void MapPane(textbox_t * tb, uint8_t r)
+{
+    uint16_t R;
+    uint8_t s;
+    uint8_t n, folded;
+    if (r > 0) {
+        R = tb->map_R[r-1];
+        s = tb->map_s[r-1]+1;
+        if (s >= (tb->map_n[r-1] & MAP_SEGMENTS)) {
+            R = FoldEnd(R) + 1;
+            s = 0;
+        }
+    } else {
+        if (FoldStart(tb->offset_r) != tb->offset_r) { // the top row was folded
+            tb->offset_r = FoldStart(tb->offset_r);
+            tb->offset_s = 0;
+        }
+        R = tb->offset_r;
+        s = tb->offset_s;
+        if (s >= RowSegments(tb, R)) { // the top row was unwrapped
+            s = RowSegments(tb, R)-1;
+            tb->offset_s = s;
+        }
+    }
+    for (; r < tb->h; r++) {
+        uint16_t end = FoldEnd(R);
+        n = RowSegments(tb, R);
+        folded = (end != R) ? MAP_FOLDED : 0;
+        if (R != tb->map_R[r] || s != tb->map_s[r] || (n | folded) != tb->map_n[r]) {
+            tb->map_R[r] = R;
+            tb->map_s[r] = s;
+            tb->map_n[r] = n | folded;
+            SetTextboxRowDirty(tb, r);
+        }
+        if (++s >= n) {
+            R = end + 1;
+            s = 0;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Returns the first display row of pane tb showing doc row R, or a later
+// doc row, or the pane's height if there is none. The map only goes down
+// the doc, so it's searched by halving.
+// ---------------------------------------------------------------------------
+static uint8_t PaneRowFrom(textbox_t * tb, uint16_t R)
+{
+    uint8_t lo = 0;
+    uint8_t hi = tb->h;
+    while (lo < hi) {
+        uint8_t mid = (lo + hi) / 2;
+        if (tb->map_R[mid] < R) {
+            lo = mid+1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// ---------------------------------------------------------------------------
+// Returns the first display row of pane tb showing doc row R, or -1
+// ---------------------------------------------------------------------------
+static int16_t PaneRowOf(textbox_t * tb, uint16_t R)
+{
+    uint8_t r = PaneRowFrom(tb, R);
+    return (r < tb->h && tb->map_R[r] == R) ? r : -1;
+}
+
+// ---------------------------------------------------------------------------
+// Returns the display row of pane tb that doc row R, col C is shown on, or
+// -1 if that is above the pane, or the pane's height if below it
+// ---------------------------------------------------------------------------
+static int16_t PaneRowAt(textbox_t * tb, uint16_t R, uint16_t C)
+{
+    uint8_t s = SegmentOf(tb, R, C);
+    int16_t r = PaneRowOf(tb, R);
+    if (R < tb->offset_r || (R == tb->offset_r && s < tb->offset_s)) {
+        return -1;
+    }
+    if (r < 0) {
+        return tb->h;
+    }
+    r += s - tb->map_s[r];
+    return (r < tb->h) ? r : tb->h;
+}
+
+// ---------------------------------------------------------------------------
+// Returns how many display rows doc row R1, segment s1 is below R0, s0 in
+// pane tb, or minus how many above, counting no further than its height
+// ---------------------------------------------------------------------------
+static int16_t LinesBetween(textbox_t * tb, uint16_t R0, uint8_t s0, uint16_t R1, uint8_t s1)
+{
+    int16_t n = 0;
+    if (!soft_wrap && TheDoc.num_folds == 0) {
+        return (int16_t)R1 - (int16_t)R0;
+    }
+    if (R1 < R0 || (R1 == R0 && s1 < s0)) {
+        return -LinesBetween(tb, R1, s1, R0, s0);
+    }
+    while ((R0 != R1 || s0 != s1) && n < tb->h) {
+        NextSegment(tb, &R0, &s0);
+        n++;
+    }
+    return n;
+}
+
+// ---------------------------------------------------------------------------
+// The cursor is an underline bar bitmap on its own plane, like the mouse
+// pointer, so showing, hiding and moving it never touch the canvas
+// ---------------------------------------------------------------------------
+static void InitCursor(void)
+{
+    uint8_t i;
+    RIA.addr0 = cursor_data;
+    RIA.step0 = 1;
+    for (i = 0; i < CURSOR_W*CURSOR_H; i++) {
+        RIA.rw0 = cursor_clr;
+    }
+    xram0_struct_set(cursor_struct, vga_mode3_config_t, x_wrap, false);
+    xram0_struct_set(cursor_struct, vga_mode3_config_t, y_wrap, false);
+    xram0_struct_set(cursor_struct, vga_mode3_config_t, x_pos_px, 0);
+    xram0_struct_set(cursor_struct, vga_mode3_config_t, y_pos_px, -CURSOR_H);
+    xram0_struct_set(cursor_struct, vga_mode3_config_t, width_px, CURSOR_W);
+    xram0_struct_set(cursor_struct, vga_mode3_config_t, height_px, CURSOR_H);
+    xram0_struct_set(cursor_struct, vga_mode3_config_t, xram_data_ptr, cursor_data);
+    xram0_struct_set(cursor_struct, vga_mode3_config_t, xram_palette_ptr, 0xFFFF);
+    xregn( 1, 0, 1, 4, 3, 3, cursor_struct, 1); // mode3 (bitmap), 8-bit color, plane1
+}
+
+// ---------------------------------------------------------------------------
+// Shows the cursor bar under the cell at display row, col, or hides it
+// above the display. While a popup's overlay has plane 1, the cursor is
+// shown by inverting the cell's colors instead, which is undone unless
+// the cell was redrawn since.
+// ---------------------------------------------------------------------------
+static void PlaceCursor(bool show, uint8_t row, uint8_t col)
+{
+    char ch;
+    uint8_t bg, fg;
+    if (OverlayOpen()) {
+        if (cur_inverted) {
+            GetChar(cur_r, cur_c, &ch, &bg, &fg);
+            if (bg == cur_fg && fg == cur_bg) {
+                DrawChar(cur_r, cur_c, ch, cur_bg, cur_fg);
+            }
+            cur_inverted = false;
+        }
+        if (show) {
+            GetChar(row, col, &ch, &cur_bg, &cur_fg);
+            DrawChar(row, col, ch, cur_fg, cur_bg);
+            cur_inverted = true;
+        }
+    } else if (show) {
+        xram0_struct_set(cursor_struct, vga_mode3_config_t, x_pos_px, col*font_width());
+        xram0_struct_set(cursor_struct, vga_mode3_config_t, y_pos_px, (row+1)*font_height() - CURSOR_H);
+    } else {
+        xram0_struct_set(cursor_struct, vga_mode3_config_t, y_pos_px, -CURSOR_H);
+    }
+}
 
 // ---------------------------------------------------------------------------
 // ---------------------------------------------------------------------------
 void InitTextbox(void)
 {
+    uint8_t i;
+    CloseHexView();
     ClearDoc(false);
+    InitSyntax();
+    InitCursor();
+    for (i = 0; i < NUM_PANES; i++) {
+        ThePanes[i].offset_r = 0;
+        ThePanes[i].offset_s = 0;
+        ThePanes[i].cursor_r = 0;
+        ThePanes[i].cursor_c = 0;
+    }
 
     // force redraw of textbox background
     mark_start.row = mark_end.row = TheDoc.cursor_r;
     mark_start.col = mark_end.col = TheDoc.cursor_c;
     mark_state = UNMARKED;
+    mark_shown = false; // all rows are drawn afresh, without highlight
     SetAllTextboxRowsDirty();
 }
 
 // ---------------------------------------------------------------------------
+// Blinks the cursor, or moves it if it's showing and the cursor moved
 // ---------------------------------------------------------------------------
 void UpdateCursor()
 {
-    char ch;
-    uint8_t fg, bg, new_row, new_col;
+    int16_t new_row;
+    uint8_t new_col;
 
     if (p_popup != NULL && popuptype == FILEDIALOG) {
         new_row = TheDoc.cur_filename_r;
         new_col = TheDoc.cur_filename_c;
+    } else if (HexView()) {
+        HexCursorCell(&new_row, &new_col);
     } else {
         // if cursor is beyond doc's last row, move it to last row
         if (TheDoc.cursor_r > TheDoc.last_row) {
             TheDoc.cursor_r = TheDoc.last_row;
         }
-        new_row = TheTextbox.r + TheDoc.cursor_r - TheDoc.offset_r;
+        // if cursor is in a fold, move it to the fold's row
+        TheDoc.cursor_r = FoldStart(TheDoc.cursor_r);
         // if cursor is beyond new rows's length, move it left appropriately
-        if (TheDoc.cursor_c > TheDoc.rows[new_row + TheDoc.offset_r - TheTextbox.r].len) {
-            TheDoc.cursor_c = TheDoc.rows[new_row + TheDoc.offset_r - TheTextbox.r].len;
+        if (TheDoc.cursor_c > TheDoc.rows[TheDoc.cursor_r].len) {
+            TheDoc.cursor_c = TheDoc.rows[TheDoc.cursor_r].len;
         }
-        new_col = TheTextbox.c + TheDoc.cursor_c;
+        new_row = TheTextbox->r + PaneRowAt(TheTextbox, TheDoc.cursor_r, TheDoc.cursor_c);
+        new_col = TheTextbox->c + TheDoc.cursor_c -
+                  SegmentOf(TheTextbox, TheDoc.cursor_r, TheDoc.cursor_c) * WrapWidth(TheTextbox);
     }
 
-    if (cur_state == BLINK_ON) {
-        // get current data
-        GetChar(cur_r, cur_c, &ch, &bg, &fg);
-        // restore original colors
-        DrawChar(cur_r, cur_c, ch, fg, bg);
+    // don't show cursor
+    // if popup other than FILEDIALOG is present,
+    // or outside the active pane
+    if ((p_popup != NULL && popuptype != FILEDIALOG) || gliding ||
+        (popuptype != FILEDIALOG &&
+         (new_row < TheTextbox->r || new_row >= TheTextbox->r + TheTextbox->h)) ||
+        !TheTextbox->in_focus) {
+        PlaceCursor(false, 0, 0);
+        cur_state = BLINK_OFF;
+    } else if (cur_state == BLINK_ON && new_row == cur_r && new_col == cur_c) {
+        PlaceCursor(false, 0, 0);
         cur_state = BLINK_OFF;
     } else {
-        // don't update cursor
-        // if popup other than FILEDIALOG is present,
-        // or in Main menu or status bar
-        if ((p_popup != NULL && popuptype != FILEDIALOG) ||
-            (new_row == 0 || new_row == DOC_ROWS_DISPLAYED+1)) {
-            return;
-        } else if (TheTextbox.in_focus) {
-            bool moving = (new_row != cur_r || new_col != cur_c);
-            uint8_t r = moving ? new_row : cur_r;
-            uint8_t c = moving ? new_col : cur_c;
-            // get current data
-            GetChar(r, c, &ch, &bg, &fg);
-            // reverse colors to show cursor
-            DrawChar(r, c, ch, fg, bg);
-            cur_state = BLINK_ON;
-        }
+        PlaceCursor(true, new_row, new_col);
+        cur_state = BLINK_ON;
     }
     cur_r = new_row;
     cur_c = new_col;
@@ -125,17 +438,10 @@ void UpdateCursor()
 // ---------------------------------------------------------------------------
 void UpdateTextboxFocus(bool has_focus)
 {
-    TheTextbox.in_focus = has_focus;
-    if (TheTextbox.in_focus == false) {
-        if (cur_state == BLINK_ON) {
-            char ch;
-            uint8_t fg, bg;
-            // get current data
-            GetChar(cur_r, cur_c, &ch, &bg, &fg);
-            // restore original colors
-            DrawChar(cur_r, cur_c, ch, fg, bg);
-            cur_state = BLINK_OFF;
-        }
+    TheTextbox->in_focus = has_focus;
+    if (TheTextbox->in_focus == false) {
+        PlaceCursor(false, 0, 0);
+        cur_state = BLINK_OFF;
     }
     UpdateCursor();
 }
@@ -178,16 +484,222 @@ static void ComputeMarkLimits(void)
 }
 
 // ---------------------------------------------------------------------------
-// Called by main loop periodically to redraw document in textbox
+// Draws the cells s to e-1 of textbox row r that are in its dirty span,
+// in the foreground colors fg. Text is drawn beneath any popup's overlay.
+// ---------------------------------------------------------------------------
+static void DrawTextboxCells(textbox_t * tb, uint8_t r, const char * row, const uint8_t * fg,
+                             uint8_t s, uint8_t e, uint8_t bg)
+{
+    uint8_t c0 = tb->dirty_c0[r];
+    uint8_t c1 = tb->dirty_c1[r] + 1;
+    s = (s > c0) ? s : c0;
+    e = (e < c1) ? e : c1;
+    if (s < e) {
+        DrawBeneathOverlay(true);
+        DrawColoredSpan(tb->r+r, tb->c+s, row+s, fg+s, e-s, bg);
+        DrawBeneathOverlay(false);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Hashes the text a textbox row shows, the rest of what it shows being kept
+// exactly in its row_shown
+// ---------------------------------------------------------------------------
+static uint16_t RowSignature(const char * row, uint8_t len)
+{
+    uint16_t sig = (uint16_t)len << 8;
+    uint8_t i;
+    for (i = 0; i < len; i++) {
+        sig = ((sig << 5) | (sig >> 11)) ^ (uint8_t)row[i];
+    }
+    return (sig != NO_SIGNATURE) ? sig : 1;
+}
+
+// ---------------------------------------------------------------------------
+// Draws the dirty span of row r of pane tb, which shows the segment of doc
+// row R its map says, unless its row_shown says it already shows exactly
+// that. Returns the number of cells drawn. The row is only lexed for its
+// colors when drawn, all of it, as a segment's colors can depend on the
+// ones before it.
+// ---------------------------------------------------------------------------
+static uint8_t DrawTextboxRow(textbox_t * tb, uint8_t r)
+{
+    uint16_t R = tb->map_R[r];
+    uint8_t s0 = tb->map_s[r] * WrapWidth(tb); // doc col shown first
+    uint8_t a = 0; // marked cells are a to b-1
+    uint8_t b = 0;
+    uint8_t len = 0;
+    uint8_t drawn = 0;
+    uint8_t lex = SyntaxStartState(R);
+    bool folded = (tb->map_n[r] & MAP_FOLDED) != 0;
+    row_shown_t * shown = &tb->row_shown[r];
+    uint16_t sig;
+    char row[DOC_COLS+1];
+    uint8_t fg[DOC_COLS+1];
+    memset(row, ' ', DOC_COLS+1); // '\n' and rows beyond the last show as spaces
+    if (R <= TheDoc.last_row) {
+        len = TheDoc.rows[R].len;
+        ReadStr(TheDoc.rows[R].ptxt, row, len);
+        if (mark_shown && R >= mark_min_r && R <= mark_max_r) {
+            a = (R == mark_min_r) ? mark_min_c : 0;
+            b = (R == mark_max_r && mark_max_c < len) ? mark_max_c+1 : len+1;
+            a = (a < b) ? a : b;
+        }
+    }
+    sig = RowSignature(row, len);
+    if (sig != shown->sig || R != shown->R || tb->map_s[r] != shown->s ||
+        a != shown->a || b != shown->b || lex != shown->lex || folded != shown->folded) {
+        shown->sig = sig;
+        shown->R = R;
+        shown->s = tb->map_s[r];
+        shown->a = a;
+        shown->b = b;
+        shown->lex = lex;
+        shown->folded = folded;
+        memset(fg, tb->fg, DOC_COLS+1);
+        LexRow(row, len, lex, fg);
+        if (folded && len + FOLD_MARK_W <= DOC_COLS) { // after the text
+            memcpy(row + len+1, FOLD_MARK, FOLD_MARK_W);
+            memset(fg + len+1, DARK_GRAY, FOLD_MARK_W);
+        }
+        if (s0 > 0) { // move the segment to the pane's left
+            memmove(row, row + s0, DOC_COLS+1 - s0);
+            memmove(fg, fg + s0, DOC_COLS+1 - s0);
+            memset(row + DOC_COLS+1 - s0, ' ', s0);
+            memset(fg + DOC_COLS+1 - s0, tb->fg, s0);
+            a = (a > s0) ? a - s0 : 0;
+            b = (b > s0) ? b - s0 : 0;
+        }
+        if (SyntaxActive()) {
+            // an edit can recolor the rest of the word it's in
+            tb->dirty_c0[r] = SyntaxTokenStart(row, tb->dirty_c0[r]);
+        }
+        DrawTextboxCells(tb, r, row, fg, 0, a, tb->bg);
+        DrawTextboxCells(tb, r, row, fg, a, b, DARK_GREEN);
+        DrawTextboxCells(tb, r, row, fg, b, tb->w, tb->bg);
+        drawn = tb->dirty_c1[r] - tb->dirty_c0[r] + 1;
+    }
+    tb->dirty_c0[r] = NOT_DIRTY;
+    tb->dirty_c1[r] = 0;
+    return drawn;
+}
+
+// ---------------------------------------------------------------------------
+// Draws the line number in the gutter of row r of pane tb, if showing and not
+// already drawn. Numbers move with their rows when the textbox scrolls, so
+// only rows scrolled into view, or past the last row, are ever renumbered.
+// A wrapped row's number is only on its first segment.
+// ---------------------------------------------------------------------------
+static void DrawGutterRow(textbox_t * tb, uint8_t r)
+{
+    uint16_t R = tb->map_R[r];
+    uint16_t num = (tb->map_s[r] == 0 && R <= TheDoc.last_row) ? R+1 : 0;
+    if (tb->c > 0 && num != tb->gutter_num[r]) {
+        char digits[GUTTER_W];
+        uint8_t i = GUTTER_W-1; // right aligned, before the space
+        uint16_t n;
+        memset(digits, ' ', GUTTER_W);
+        for (n = num; n > 0 && i > 0; n /= 10) {
+            digits[--i] = '0' + n % 10;
+        }
+        DrawBeneathOverlay(true);
+        DrawSpan(tb->r+r, 0, digits, GUTTER_W, tb->bg, DARK_GRAY);
+        DrawBeneathOverlay(false);
+        tb->gutter_num[r] = num;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Returns the doc rows the scrollbar of pane tb stands for: all of the doc,
+// and any rows past its end the pane is scrolled over
+// ---------------------------------------------------------------------------
+static uint16_t ScrollbarRows(textbox_t * tb)
+{
+    uint16_t rows = TheDoc.last_row+1;
+    return (rows > tb->offset_r + tb->h) ? rows : tb->offset_r + tb->h;
+}
+
+// ---------------------------------------------------------------------------
+// Draws the scrollbar of pane tb, in the display's last column. Each of its
+// cells stands for an equal part of the doc, and shows the thumb if part
+// of it is in view, and a marker if a bookmark is in it. Nothing is done
+// unless the offset, the doc's length or a bookmark moved, and then only
+// the cells that changed are drawn.
+// ---------------------------------------------------------------------------
+static void DrawScrollbar(textbox_t * tb)
+{
+    uint8_t cell[DOC_ROWS_DISPLAYED];
+    uint16_t rows = ScrollbarRows(tb);
+    uint8_t h = tb->h;
+    uint8_t a, b, r, i;
+    if (bar_w == 0 || (h == tb->bar_h &&
+                       tb->offset_r == tb->bar_offset_r &&
+                       TheDoc.last_row == tb->bar_last_row &&
+                       memcmp(TheDoc.bookmarks, tb->bar_marks, sizeof(tb->bar_marks)) == 0)) {
+        return;
+    }
+    // thumb is cells a to b-1, at least one cell
+    a = (uint16_t)(tb->offset_r * h) / rows;
+    b = (uint16_t)((tb->offset_r + h) * h + rows-1) / rows;
+    b = (b > a) ? b : a+1;
+    for (r = 0; r < h; r++) {
+        cell[r] = (r >= a && r < b) ? BAR_THUMB : BAR_TRACK;
+    }
+    for (i = 0; i < NUM_BOOKMARKS; i++) {
+        uint16_t R = TheDoc.bookmarks[i];
+        if (R <= TheDoc.last_row) {
+            cell[(uint16_t)(R * h) / rows] |= BAR_MARK;
+        }
+    }
+    DrawBeneathOverlay(true);
+    for (r = 0; r < h; r++) {
+        if (cell[r] != tb->bar_cell[r]) {
+            DrawChar(tb->r+r, canvas_cols()-1,
+                     (cell[r] & BAR_THUMB) ? 0xDB : 0xB0, // full block, light shade
+                     tb->bg,
+                     (cell[r] & BAR_MARK) ? YELLOW : (cell[r] & BAR_THUMB) ? LIGHT_GRAY : DARK_GRAY);
+            tb->bar_cell[r] = cell[r];
+        }
+    }
+    DrawBeneathOverlay(false);
+    tb->bar_offset_r = tb->offset_r;
+    tb->bar_last_row = TheDoc.last_row;
+    tb->bar_h = h;
+    memcpy(tb->bar_marks, TheDoc.bookmarks, sizeof(tb->bar_marks));
+}
+
+// ---------------------------------------------------------------------------
+// Draws row r of pane tb if it is dirty and budget is left, and returns what
+// is left of the budget. Rows skipped by their signature only cost the
+// reading and hashing.
+// ---------------------------------------------------------------------------
+static int16_t DrawTextboxRowInBudget(textbox_t * tb, int16_t r, int16_t budget)
+{
+    if (budget > 0 && r >= 0 && r < tb->h &&
+        tb->dirty_c0[r] <= tb->dirty_c1[r] && SyntaxKnown(tb->map_R[r])) {
+        budget -= DrawTextboxRow(tb, r) + signature_cost;
+    }
+    return budget;
+}
+
+// ---------------------------------------------------------------------------
+// Called by main loop every frame to redraw document in textbox. At most
+// about render_budget dirty cells are drawn per frame, starting with the
+// cursor row and then rows outward from it, then the other pane's rows,
+// and the rest carry over to the next frame, so big repaints never hold
+// up the keyboard and mouse.
 // ---------------------------------------------------------------------------
 void UpdateTextbox(void)
 {
     static uint16_t cursor_timer = 0;
-    static uint16_t update_timer = 0;
+    int16_t budget = render_budget;
+    int16_t r0 = PaneRowAt(TheTextbox, TheDoc.cursor_r, TheDoc.cursor_c);
+    uint16_t bottom = 0; // lowest doc row shown, in either pane
+    int8_t d;
+    uint8_t i;
 
     // update timer counts
     cursor_timer++;
-    update_timer++;
 
     // blink the cursor
     if (cursor_timer > cur_threshold) {
@@ -195,60 +707,551 @@ void UpdateTextbox(void)
         UpdateCursor();
     }
 
-    // redraw any dirty or marked rows
-    if (update_timer > update_threshold) {
-        update_timer = 0;
-        if (p_popup == NULL) {
-            uint8_t r, c;
-            char row[DOC_COLS];
-            ComputeMarkLimits();
-            for (r = 0; r < TheTextbox.h; r++) {
-                uint16_t R = r + TheDoc.offset_r;
-                if (R <= TheDoc.last_row) {
-                    bool marked_row = (mark_state != UNMARKED &&
-                                    R >= mark_min_r && R <= mark_max_r);
-                    if (TheTextbox.row_dirty[r]) {
-                        UpdateTextboxFocus(false);
-                        memset(row, 0, DOC_COLS);
-                        ReadStr(TheDoc.rows[R].ptxt, row, TheDoc.rows[R].len+1);
-                        for (c = 0; c < TheTextbox.w; c++) {
-                            bool marked_ch = (marked_row &&
-                                            !(R == mark_min_r && c < mark_min_c) &&
-                                            !(R == mark_max_r && c > mark_max_c));
-                            if (c < TheDoc.rows[R].len+1) {
-                                char ch = row[c];
-                                if (ch == '\n') {
-                                    ch = ' ';
-                                }
-                                DrawChar(TheTextbox.r+r,
-                                        TheTextbox.c+c,
-                                        ch,
-                                        marked_ch ? DARK_GREEN
-                                                 : TheTextbox.bg, TheTextbox.fg);
-                            } else { // fill remainder of line with spaces
-                                DrawChar(TheTextbox.r+r,
-                                        TheTextbox.c+c,
-                                        ' ',
-                                        TheTextbox.bg,
-                                        TheTextbox.fg);
-                            }
-                        }
-                        TheTextbox.row_dirty[r] = false;
-                        UpdateTextboxFocus(true);
+    if (HexView()) { // a binary file is shown instead of the doc
+        UpdateHexView();
+        return;
+    }
+
+    Glide();
+
+    // redraw dirty rows, nearest the cursor first. Rows whose syntax
+    // colors aren't known yet, as the rows above them are still being
+    // re-lexed, a few a frame, are left for a later frame. Popups are on
+    // the overlay, so the text under them is kept up to date too.
+    for (i = 0; i < num_panes; i++) {
+        if (ThePanes[i].map_R[ThePanes[i].h - 1] > bottom) {
+            bottom = ThePanes[i].map_R[ThePanes[i].h - 1];
+        }
+    }
+    RelexRows(bottom);
+    for (i = 0; i < num_panes; i++) {
+        textbox_t * tb = &ThePanes[i];
+        for (d = 0; d < tb->h; d++) {
+            DrawGutterRow(tb, d);
+        }
+        DrawScrollbar(tb);
+    }
+    r0 = (r0 < 0) ? 0 : (r0 < TheTextbox->h) ? r0 : TheTextbox->h-1;
+    for (d = 0; d < TheTextbox->h && budget > 0; d++) {
+        budget = DrawTextboxRowInBudget(TheTextbox, r0 + d, budget);
+        if (d > 0) {
+            budget = DrawTextboxRowInBudget(TheTextbox, r0 - d, budget);
+        }
+    }
+    for (i = 0; i < num_panes; i++) {
+        textbox_t * tb = &ThePanes[i];
+        for (d = 0; tb != TheTextbox && d < tb->h && budget > 0; d++) {
+            budget = DrawTextboxRowInBudget(tb, d, budget);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Scrolls the active pane so segment seg of doc row offset is at its top.
+// Scrolls of less than a full pane move its text rows ring in hardware,
+// and only the rows scrolled into view are mapped and drawn, right away,
+// so nothing stale shows.
+// ---------------------------------------------------------------------------
+static void ScrollTextbox(uint16_t offset, uint8_t seg)
+{
+    textbox_t * tb = TheTextbox;
+    int16_t n = LinesBetween(tb, tb->offset_r, tb->offset_s, offset, seg);
+    uint8_t h = tb->h;
+    uint8_t r;
+    if (n == 0) {
+        return;
+    }
+    tb->offset_r = offset;
+    tb->offset_s = seg;
+    if (n <= -(int16_t)h || n >= (int16_t)h) {
+        MapPane(tb, 0);
+        for (r = 0; r < h; r++) {
+            SetTextboxRowDirty(tb, r);
+        }
+        return;
+    }
+    ScrollTextRows(tb->ring, n);
+    tb->bar_h = NO_BAR_H;
+    if (n > 0) { // dirty spans and what rows show move up with their rows
+        memmove(&tb->dirty_c0[0], &tb->dirty_c0[n], h-n);
+        memmove(&tb->dirty_c1[0], &tb->dirty_c1[n], h-n);
+        memmove(&tb->row_shown[0], &tb->row_shown[n], (h-n)*sizeof(row_shown_t));
+        memmove(&tb->gutter_num[0], &tb->gutter_num[n], (h-n)*sizeof(uint16_t));
+        memmove(&tb->bar_cell[0], &tb->bar_cell[n], h-n);
+        memmove(&tb->map_R[0], &tb->map_R[n], (h-n)*sizeof(uint16_t));
+        memmove(&tb->map_s[0], &tb->map_s[n], h-n);
+        memmove(&tb->map_n[0], &tb->map_n[n], h-n);
+        MapPane(tb, h-n);
+        for (r = h-n; r < h; r++) {
+            tb->bar_cell[r] = NO_BAR_CELL;
+            tb->row_shown[r].sig = NO_SIGNATURE;
+            tb->gutter_num[r] = NO_LINE_NUM;
+            SetTextboxRowDirty(tb, r);
+            DrawTextboxRow(tb, r);
+            DrawGutterRow(tb, r);
+        }
+    } else {
+        memmove(&tb->dirty_c0[-n], &tb->dirty_c0[0], h+n);
+        memmove(&tb->dirty_c1[-n], &tb->dirty_c1[0], h+n);
+        memmove(&tb->row_shown[-n], &tb->row_shown[0], (h+n)*sizeof(row_shown_t));
+        memmove(&tb->gutter_num[-n], &tb->gutter_num[0], (h+n)*sizeof(uint16_t));
+        memmove(&tb->bar_cell[-n], &tb->bar_cell[0], h+n);
+        memmove(&tb->map_R[-n], &tb->map_R[0], (h+n)*sizeof(uint16_t));
+        memmove(&tb->map_s[-n], &tb->map_s[0], h+n);
+        memmove(&tb->map_n[-n], &tb->map_n[0], h+n);
+        MapPane(tb, 0);
+        for (r = 0; r < -n; r++) {
+            tb->bar_cell[r] = NO_BAR_CELL;
+            tb->row_shown[r].sig = NO_SIGNATURE;
+            tb->gutter_num[r] = NO_LINE_NUM;
+            SetTextboxRowDirty(tb, r);
+            DrawTextboxRow(tb, r);
+            DrawGutterRow(tb, r);
+        }
+    }
+    DrawScrollbar(tb);
+}
+
+// ---------------------------------------------------------------------------
+// Scrolls the active pane a display row further towards glide_to, each
+// frame. The row scrolled in is drawn as soon as its row starts, while it
+// is still in the ring's margin, and then the ring is nudged back to its
+// place over a few frames: a row a frame while more than two rows are
+// left, and a quarter row a frame for the last ones. Once there, the pane
+// is scrolled to the cursor, which wrapped rows can have paged out of view.
+// ---------------------------------------------------------------------------
+static void Glide(void)
+{
+    textbox_t * tb = TheTextbox;
+    uint8_t fh = font_height();
+    uint16_t left;
+    uint16_t R = tb->offset_r;
+    uint8_t s = tb->offset_s;
+    if (!gliding) {
+        return;
+    }
+    if (glide_px == 0) {
+        if (R == glide_to && s == 0) {
+            gliding = false;
+            ScrollToCursor();
+            UpdateCursor();
+            return;
+        }
+        glide_dir = (glide_to > R) ? 1 : -1;
+        if (glide_dir > 0) {
+            NextSegment(tb, &R, &s);
+        } else {
+            PrevSegment(tb, &R, &s);
+        }
+        ScrollTextbox(R, s);
+        glide_px = fh;
+    }
+    left = (glide_to > TheTextbox->offset_r) ? glide_to - TheTextbox->offset_r
+                                              : TheTextbox->offset_r - glide_to;
+    glide_px -= (left > 2) ? glide_px : fh/4;
+    NudgeTextRows(TheTextbox->ring, glide_dir * (int8_t)glide_px);
+}
+
+// ---------------------------------------------------------------------------
+// Ends any smooth scroll, by jumping to where it was going
+// ---------------------------------------------------------------------------
+void FinishGlide(void)
+{
+    if (gliding) {
+        gliding = false;
+        glide_px = 0;
+        NudgeTextRows(TheTextbox->ring, 0);
+        ScrollTextbox(glide_to, 0);
+        UpdateCursor();
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Scrolls the active pane so doc row offset is at its top, at once
+// ---------------------------------------------------------------------------
+void SetTextboxOffset(uint16_t offset)
+{
+    FinishGlide();
+    ScrollTextbox(offset, 0);
+}
+
+// ---------------------------------------------------------------------------
+// Scrolls the active pane so doc row offset is at its top, smoothly over
+// the next frames if smooth scrolling is on. If already scrolling, it just
+// heads to the new offset instead.
+// ---------------------------------------------------------------------------
+void GlideTextboxOffset(uint16_t offset)
+{
+    if (!smooth_scroll) {
+        SetTextboxOffset(offset);
+        ScrollToCursor();
+    } else {
+        glide_to = FoldStart(offset); // a row it can step onto
+        gliding = true;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Returns the offset_r the active pane is scrolling to, or is at
+// ---------------------------------------------------------------------------
+uint16_t TextboxScrollTarget(void)
+{
+    return gliding ? glide_to : TheTextbox->offset_r;
+}
+
+// ---------------------------------------------------------------------------
+// Scrolls the active pane n rows down the doc (up, if negative), as far as
+// the last row at the top, taking the cursor along if it would go out of
+// view, as the mouse wheel does. A fold counts as one row.
+// ---------------------------------------------------------------------------
+void GlideTextbox(int16_t n)
+{
+    uint16_t offset = StepShownRows(TextboxScrollTarget(), n);
+    uint16_t bottom = StepShownRows(offset, TheTextbox->h-1);
+    if (TheDoc.cursor_r < offset) {
+        ClearMarkedText();
+        TheDoc.cursor_r = offset;
+    } else if (TheDoc.cursor_r > bottom) {
+        ClearMarkedText();
+        TheDoc.cursor_r = bottom;
+    }
+    GlideTextboxOffset(offset);
+    UpdateCursor();
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void SetSmoothScroll(bool smooth)
+{
+    FinishGlide();
+    smooth_scroll = smooth;
+}
+bool SmoothScroll(void)
+{
+    return smooth_scroll;
+}
+
+// ---------------------------------------------------------------------------
+// Scrolls the active pane just enough to show the cursor, on its top row if
+// it's above, or its bottom row if below
+// ---------------------------------------------------------------------------
+void ScrollToCursor(void)
+{
+    textbox_t * tb = TheTextbox;
+    uint16_t R = TheDoc.cursor_r;
+    uint8_t s = SegmentOf(tb, R, TheDoc.cursor_c);
+    int16_t r;
+    FinishGlide();
+    r = PaneRowAt(tb, R, TheDoc.cursor_c);
+    if (r < 0) {
+        ScrollTextbox(R, s);
+    } else if (r >= tb->h) {
+        if (!soft_wrap && TheDoc.num_folds == 0) {
+            R = (R > tb->h-1) ? R - (tb->h-1) : 0;
+        } else {
+            for (r = 0; r < tb->h-1; r++) {
+                PrevSegment(tb, &R, &s);
+            }
+        }
+        ScrollTextbox(R, s);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Moves the cursor a display row down or up, to the next or previous doc
+// row, or while wrapping maybe another segment of the same one, keeping its
+// column on the display. The active pane is scrolled to keep it in view.
+// Returns false if there is no row to move to.
+// ---------------------------------------------------------------------------
+bool MoveCursorLine(bool down)
+{
+    textbox_t * tb = TheTextbox;
+    uint8_t w = WrapWidth(tb);
+    uint16_t R = TheDoc.cursor_r;
+    uint8_t s = SegmentOf(tb, R, TheDoc.cursor_c);
+    uint8_t c = TheDoc.cursor_c - s*w; // col in the segment
+    if (down) {
+        if (s+1 < RowSegments(tb, R)) {
+            s++;
+        } else if (FoldEnd(R) < TheDoc.last_row) {
+            R = FoldEnd(R) + 1;
+            s = 0;
+        } else {
+            return false;
+        }
+    } else {
+        if (s > 0) {
+            s--;
+        } else if (R > 0) {
+            R = FoldStart(R-1);
+            s = RowSegments(tb, R)-1;
+        } else {
+            return false;
+        }
+    }
+    TheDoc.cursor_r = R;
+    TheDoc.cursor_c = s*w + c; // UpdateCursor() keeps it in the row
+    ScrollToCursor();
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Returns the display row r of the active pane nearest to display row
+// ---------------------------------------------------------------------------
+static uint8_t PaneRowNear(uint8_t row)
+{
+    if (row < TheTextbox->r) {
+        return 0;
+    }
+    row -= TheTextbox->r;
+    return (row < TheTextbox->h) ? row : TheTextbox->h-1;
+}
+
+// ---------------------------------------------------------------------------
+// Returns the doc row shown at display row in the active pane, for the
+// mouse. Rows above or below the pane give its top or bottom row's.
+// ---------------------------------------------------------------------------
+uint16_t DocRowAt(uint8_t row)
+{
+    return TheTextbox->map_R[PaneRowNear(row)];
+}
+
+// ---------------------------------------------------------------------------
+// Returns the doc col shown at display row, col in the active pane
+// ---------------------------------------------------------------------------
+uint16_t DocColAt(uint8_t row, uint8_t col)
+{
+    uint8_t r = PaneRowNear(row);
+    uint8_t c = (col > TheTextbox->c) ? (col - TheTextbox->c) : 0; // gutter is col 0
+    return c + TheTextbox->map_s[r] * WrapWidth(TheTextbox);
+}
+
+// ---------------------------------------------------------------------------
+// Has every row of every pane drawn from scratch, after the text moved
+// on the display
+// ---------------------------------------------------------------------------
+void RedrawAllPanes(void)
+{
+    uint8_t i, r;
+    for (i = 0; i < num_panes; i++) {
+        for (r = 0; r < ThePanes[i].h; r++) {
+            ThePanes[i].row_shown[r].sig = NO_SIGNATURE;
+            ThePanes[i].gutter_num[r] = NO_LINE_NUM;
+            ThePanes[i].bar_cell[r] = NO_BAR_CELL;
+        }
+        ThePanes[i].bar_h = NO_BAR_H;
+    }
+    SetAllTextboxRowsDirty();
+}
+
+// ---------------------------------------------------------------------------
+// Shows or hides the line number gutter, at the left of the panes, which
+// moves all the text, so it all has to be redrawn. While the gutter shows,
+// text past the textbox's width is clipped.
+// ---------------------------------------------------------------------------
+void ShowLineNumbers(bool show)
+{
+    uint8_t i;
+    for (i = 0; i < NUM_PANES; i++) {
+        ThePanes[i].c = show ? GUTTER_W : 0;
+        ThePanes[i].w = canvas_cols() - ThePanes[i].c - bar_w;
+    }
+    RedrawAllPanes();
+    ScrollToCursor(); // rows wrap at the new width
+    UpdateCursor();
+}
+
+// ---------------------------------------------------------------------------
+// Shows or hides the scrollbar, at the right of the panes. Text under it is
+// clipped, so the panes are made narrower while it shows.
+// ---------------------------------------------------------------------------
+void ShowScrollbar(bool show)
+{
+    uint8_t i;
+    bar_w = show ? SCROLLBAR_W : 0;
+    for (i = 0; i < NUM_PANES; i++) {
+        ThePanes[i].w = canvas_cols() - ThePanes[i].c - bar_w;
+    }
+    RedrawAllPanes();
+    ScrollToCursor(); // rows wrap at the new width
+    UpdateCursor();
+}
+
+// ---------------------------------------------------------------------------
+// Turns soft wrapping on or off. While on, rows wider than the panes are
+// wrapped onto the display rows below, so none of them is clipped, and
+// the panes map their display rows to the rows and segments they show.
+// ---------------------------------------------------------------------------
+void SetSoftWrap(bool wrap)
+{
+    uint8_t i;
+    FinishGlide();
+    soft_wrap = wrap;
+    for (i = 0; i < NUM_PANES; i++) {
+        ThePanes[i].offset_s = 0;
+    }
+    RedrawAllPanes();
+    ScrollToCursor();
+    UpdateCursor();
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+bool SoftWrap(void)
+{
+    return soft_wrap;
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+bool ScrollbarShown(void)
+{
+    return bar_w > 0;
+}
+
+// ---------------------------------------------------------------------------
+// If display row, col is on a pane's scrollbar, makes that pane the active
+// one, and moves its cursor to the first doc row the cell stands for, or
+// the fold it's in, scrolling there if it isn't in view. Returns false if not on a scrollbar.
+// ---------------------------------------------------------------------------
+bool ScrollbarPressed(uint8_t row, uint8_t col)
+{
+    uint16_t R;
+    if (bar_w == 0 || col != canvas_cols()-1 || !ActivatePaneAt(row)) {
+        return false;
+    }
+    R = (uint16_t)((row - TheTextbox->r) * ScrollbarRows(TheTextbox) + TheTextbox->h-1) / TheTextbox->h;
+    GotoDocRow(FoldStart((R <= TheDoc.last_row) ? R : TheDoc.last_row));
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Splits the textbox into two panes, one above the other, each scrolling in
+// its own text rows ring, or joins them back into one. The lower pane
+// starts out showing where the upper one was. The panes fill the rows
+// between the menu and status bar, so calling this again lays them out
+// for the display's current rows.
+// ---------------------------------------------------------------------------
+void SplitTextbox(bool split)
+{
+    textbox_t * top = &ThePanes[0];
+    textbox_t * bottom = &ThePanes[1];
+    uint8_t h = canvas_rows()-2;
+    FinishGlide();
+    ActivatePane(0);
+    if (split) {
+        top->h = h/2;
+        bottom->r = top->r + top->h;
+        bottom->h = h - top->h;
+        bottom->offset_r = top->offset_r;
+        bottom->offset_s = top->offset_s;
+        bottom->cursor_r = TheDoc.cursor_r;
+        bottom->cursor_c = TheDoc.cursor_c;
+        num_panes = 2;
+        SplitTextRows(top->h);
+    } else {
+        top->h = h;
+        bottom->h = 0;
+        num_panes = 1;
+        SplitTextRows(0);
+    }
+    RedrawAllPanes();
+    ScrollToCursor();
+    UpdateCursor();
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+bool TextboxSplit(void)
+{
+    return num_panes > 1;
+}
+
+// ---------------------------------------------------------------------------
+// Makes pane i the active one. The doc cursor is kept per pane, so each
+// pane goes back to where it was left.
+// ---------------------------------------------------------------------------
+void ActivatePane(uint8_t i)
+{
+    if (i < num_panes && TheTextbox != &ThePanes[i]) {
+        FinishGlide();
+        ClearMarkedText();
+        TheTextbox->cursor_r = TheDoc.cursor_r;
+        TheTextbox->cursor_c = TheDoc.cursor_c;
+        TheTextbox = &ThePanes[i];
+        TheDoc.cursor_r = FoldStart((TheTextbox->cursor_r <= TheDoc.last_row) ? TheTextbox->cursor_r
+                                                                               : TheDoc.last_row);
+        TheDoc.cursor_c = TheTextbox->cursor_c;
+        ScrollToCursor();
+        UpdateCursor();
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Makes the pane showing display row the active one, if there is one
+// ---------------------------------------------------------------------------
+bool ActivatePaneAt(uint8_t row)
+{
+    uint8_t i;
+    for (i = 0; i < num_panes; i++) {
+        if (row >= ThePanes[i].r && row < ThePanes[i].r + ThePanes[i].h) {
+            ActivatePane(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void SetAllTextboxRowsDirty(void)
+{
+    uint8_t i, r;
+    for (i = 0; i < num_panes; i++) {
+        MapPane(&ThePanes[i], 0);
+        for (r = 0; r < ThePanes[i].h; r++) {
+            SetTextboxRowDirty(&ThePanes[i], r);
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void SetTextboxRowDirty(textbox_t * tb, uint8_t r)
+{
+    tb->dirty_c0[r] = 0;
+    tb->dirty_c1[r] = tb->w-1;
+}
+
+// ----------------------------------------------------------------------------
+// Adds columns c0 to c1 of doc row R to the dirty span of the rows showing
+// it, in any pane. If the row now wraps onto more or fewer segments, the
+// rows below it in the pane are remapped.
+// ----------------------------------------------------------------------------
+void SetDocSpanDirty(uint16_t R, uint8_t c0, uint8_t c1)
+{
+    uint8_t i;
+    for (i = 0; i < num_panes; i++) {
+        textbox_t * tb = &ThePanes[i];
+        int16_t r = PaneRowOf(tb, R);
+        if (r >= 0) {
+            uint8_t w = WrapWidth(tb);
+            if (RowSegments(tb, R) != (tb->map_n[r] & MAP_SEGMENTS)) {
+                MapPane(tb, r);
+            }
+            if (tb->map_n[r] & MAP_FOLDED) { // the fold mark after the text moves
+                c1 = DOC_COLS; // the last col a row's drawn to
+            }
+            for (; r < tb->h && tb->map_R[r] == R; r++) {
+                uint8_t s0 = tb->map_s[r] * w; // doc col shown first
+                if (c1 >= s0 && c0 < s0 + w) {
+                    uint8_t a = (c0 > s0) ? c0 - s0 : 0;
+                    uint8_t b = (c1 - s0 < tb->w) ? c1 - s0 : tb->w-1;
+                    if (a < tb->dirty_c0[r]) {
+                        tb->dirty_c0[r] = a;
                     }
-                } else { // beyond last line
-                    if (TheTextbox.row_dirty[r]) {
-                        uint8_t c;
-                        UpdateTextboxFocus(false);
-                        for (c = 0; c < TheTextbox.w; c++) {
-                            DrawChar(TheTextbox.r+r,
-                                        TheTextbox.c+c,
-                                        ' ',
-                                        TheTextbox.bg,
-                                        TheTextbox.fg);
-                        }
-                        UpdateTextboxFocus(true);
-                        TheTextbox.row_dirty[r] = false;
+                    if (b > tb->dirty_c1[r]) {
+                        tb->dirty_c1[r] = b;
                     }
                 }
             }
@@ -257,12 +1260,128 @@ void UpdateTextbox(void)
 }
 
 // ----------------------------------------------------------------------------
+// Sets the rows showing doc rows first to last dirty, in any pane, after
+// remapping them and the rows below, as rows may have been added, deleted
+// or rewrapped. A last past the panes' bottom rows means all the rows from
+// first down.
 // ----------------------------------------------------------------------------
-void SetAllTextboxRowsDirty(void)
+void SetDocRowsDirty(uint16_t first, uint16_t last)
 {
-    uint8_t r;
-    for (r = 0; r < TheTextbox.h; r++) {
-        TheTextbox.row_dirty[r] = true;
+    uint8_t i;
+    for (i = 0; i < num_panes; i++) {
+        textbox_t * tb = &ThePanes[i];
+        uint8_t r = PaneRowFrom(tb, first);
+        // from the row above, which may show a fold that was just unfolded
+        MapPane(tb, (r > 0) ? r-1 : 0);
+        for (; r < tb->h && tb->map_R[r] <= last; r++) {
+            SetTextboxRowDirty(tb, r);
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Gets the doc rows the line commands act on: the marked rows, if any,
+// else just the cursor row
+// ----------------------------------------------------------------------------
+static void GetMarkedRows(uint16_t * pfirst, uint16_t * plast)
+{
+    if (mark_state == MARKED) {
+        ComputeMarkLimits();
+        *pfirst = mark_min_r;
+        *plast = (mark_max_r >= mark_min_r) ? mark_max_r : mark_min_r;
+    } else {
+        *pfirst = *plast = TheDoc.cursor_r;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+static bool MarkPtBefore(mark_pt_t a, mark_pt_t b)
+{
+    return (a.row < b.row || (a.row == b.row && a.col < b.col));
+}
+
+// ----------------------------------------------------------------------------
+// Returns R, or if a pane before pane i shows doc row R, the first row
+// after those that pane shows
+// ----------------------------------------------------------------------------
+static int16_t PastPanesBefore(uint8_t i, int16_t R)
+{
+    uint8_t j;
+    for (j = 0; j < i; j++) {
+        int16_t bottom = ThePanes[j].map_R[ThePanes[j].h-1];
+        if (R >= (int16_t)ThePanes[j].offset_r && R <= bottom) {
+            return FoldEnd(bottom) + 1;
+        }
+    }
+    return R;
+}
+
+// ----------------------------------------------------------------------------
+// Sets the cells from a up to, but not including, b dirty, if showing in
+// any pane. Each doc row the panes show is visited once, as SetDocSpanDirty
+// sets it dirty in all of them.
+// ----------------------------------------------------------------------------
+static void SetMarkSpanDirty(mark_pt_t a, mark_pt_t b)
+{
+    uint8_t i;
+    for (i = 0; i < num_panes; i++) {
+        int16_t top = ThePanes[i].offset_r;
+        int16_t bottom = ThePanes[i].map_R[ThePanes[i].h-1];
+        int16_t R = (a.row > top) ? a.row : top;
+        while (R <= b.row && R <= bottom) {
+            int16_t past = PastPanesBefore(i, R);
+            uint8_t c0 = (R == a.row) ? a.col : 0;
+            if (past != R) { // done with the pane before
+                R = past;
+                continue;
+            }
+            if (R < b.row) {
+                SetDocSpanDirty(R, c0, DOC_COLS-1);
+            } else if (b.col > c0) {
+                SetDocSpanDirty(R, c0, b.col-1);
+            }
+            R = FoldEnd(R) + 1;
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Called whenever the mark changes. Recomputes the mark limits, and sets
+// dirty only the cells whose highlight changed, i.e. those between the old
+// and new starts, and between the old and new ends.
+// ----------------------------------------------------------------------------
+static void UpdateMarkLimits(void)
+{
+    bool shown = (mark_state != UNMARKED &&
+                  (mark_start.row != mark_end.row || mark_start.col != mark_end.col));
+    bool forward = MarkPtBefore(mark_start, mark_end);
+    mark_pt_t p = forward ? mark_start : mark_end;
+    mark_pt_t q = forward ? mark_end : mark_start;
+    if (shown && mark_shown) {
+        if (MarkPtBefore(p, mark_p)) {
+            SetMarkSpanDirty(p, mark_p);
+        } else {
+            SetMarkSpanDirty(mark_p, p);
+        }
+        if (MarkPtBefore(q, mark_q)) {
+            SetMarkSpanDirty(q, mark_q);
+        } else {
+            SetMarkSpanDirty(mark_q, q);
+        }
+    } else {
+        if (mark_shown) {
+            SetMarkSpanDirty(mark_p, mark_q);
+        }
+        if (shown) {
+            SetMarkSpanDirty(p, q);
+        }
+    }
+    mark_p = p;
+    mark_q = q;
+    mark_shown = shown;
+    if (shown) {
+        ComputeMarkLimits();
     }
 }
 
@@ -274,6 +1393,7 @@ void StartMarkingText(void)
     mark_start.row = mark_end.row = TheDoc.cursor_r;
     mark_start.col = mark_end.col = TheDoc.cursor_c;
     mark_state = MARKING;
+    UpdateMarkLimits();
 }
 
 // ----------------------------------------------------------------------------
@@ -295,6 +1415,7 @@ void MarkText(void)
         mark_end.row = TheDoc.cursor_r;
         mark_end.col = TheDoc.cursor_c;
         mark_state = MARKED;
+        UpdateMarkLimits();
     }
 }
 
@@ -304,7 +1425,7 @@ void ClearMarkedText(void)
 {
     if (mark_state != UNMARKED) {
         mark_state = UNMARKED;
-        SetAllTextboxRowsDirty();
+        UpdateMarkLimits();
     }
 }
 
@@ -315,6 +1436,7 @@ void StopMarkingText(void)
     if (MarkingText(TheDoc.cursor_r, TheDoc.cursor_c)) { // marking
         mark_end.row = TheDoc.cursor_r;
         mark_end.col = TheDoc.cursor_c;
+        UpdateMarkLimits();
     } else {
         ClearMarkedText();
     }
@@ -384,6 +1506,8 @@ bool CutMarkedText(void)
         while (i++ < n) {
             DeleteChar(false);
         }
+        // everything from the cut on may have shifted
+        SetDocRowsDirty(TheDoc.cursor_r, DOC_ROWS);
     }
     return true;
 }
@@ -402,7 +1526,7 @@ bool PasteTextFromClipboard(void)
             if (!AddChar(ch)) {
                 return false;
             }
-            TheTextbox.row_dirty[TheDoc.cursor_r - TheDoc.offset_r] = true;
+            SetDocSpanDirty(TheDoc.cursor_r, TheDoc.cursor_c-1, TheDoc.rows[TheDoc.cursor_r].len-1);
         } else {
             if (!AddNewLine()) {
                 return false;
@@ -411,9 +1535,189 @@ bool PasteTextFromClipboard(void)
         }
         i++;
     }
+    ScrollToCursor();
     return true;
 }
 
+// ---------------------------------------------------------------------------
+// Moves the cursor to the start of doc row R, unfolding the fold it's in.
+// If R isn't already showing, the offset is set directly so the textbox is
+// only repainted once.
+// ---------------------------------------------------------------------------
+bool GotoDocRow(uint16_t R)
+{
+    if (R <= TheDoc.last_row) {
+        uint16_t fold = FoldStart(R);
+        ClearMarkedText();
+        if (fold != R && RemoveFold(fold)) {
+            SetDocRowsDirty(fold, fold);
+        }
+        TheDoc.cursor_r = R;
+        TheDoc.cursor_c = 0;
+        if (PaneRowOf(TheTextbox, R) < 0) {
+            SetTextboxOffset(StepShownRows(R, -(int16_t)(TheTextbox->h/2)));
+            ScrollToCursor(); // in case the rows above it wrap
+        }
+        UpdateCursor();
+        return true;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Moves the cursor row (or marked rows) up or down one row, swapping them
+// with the row above or below. Only the rows involved are redrawn.
+// ---------------------------------------------------------------------------
+bool MoveMarkedLines(bool up)
+{
+    uint16_t first, last;
+    GetMarkedRows(&first, &last);
+    if (MoveRows(first, last, up)) {
+        if (up) {
+            first--;
+            TheDoc.cursor_r--;
+        } else {
+            last++;
+            TheDoc.cursor_r++;
+        }
+        if (mark_state == MARKED) { // keep the moved rows marked
+            mark_start.row += up ? -1 : 1;
+            mark_end.row += up ? -1 : 1;
+            UpdateMarkLimits();
+        }
+        SetDocRowsDirty(first, last);
+        ScrollToCursor();
+        UpdateCursor();
+        return true;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Inserts a copy of the cursor row (or marked rows) below them
+// ---------------------------------------------------------------------------
+bool DuplicateMarkedLines(void)
+{
+    uint16_t first, last;
+    GetMarkedRows(&first, &last);
+    if (DuplicateRows(first, last)) {
+        // everything below the original rows shifted down
+        SetDocRowsDirty(last+1, DOC_ROWS);
+        return true;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Deletes the cursor row (or marked rows)
+// ---------------------------------------------------------------------------
+bool DeleteMarkedLines(void)
+{
+    uint16_t first, last;
+    GetMarkedRows(&first, &last);
+    ClearMarkedText();
+    if (DeleteRows(first, last)) {
+        TheDoc.cursor_r = (first <= TheDoc.last_row) ? first : TheDoc.last_row;
+        // everything below the deleted rows shifted up
+        SetDocRowsDirty(TheDoc.cursor_r, DOC_ROWS);
+        ScrollToCursor();
+        UpdateCursor();
+        return true;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Folds the marked rows under the first of them, or the block the cursor
+// row starts, by its braces or indent. If the cursor row already shows a
+// fold, it's unfolded instead. Only the rows below the fold's first are
+// remapped, and the fold scrolls past as one row.
+// ---------------------------------------------------------------------------
+bool FoldMarkedLines(void)
+{
+    uint16_t first, last;
+    GetMarkedRows(&first, &last);
+    ClearMarkedText();
+    if (first == last) {
+        if (RemoveFold(first)) {
+            SetDocRowsDirty(first, first);
+            UpdateCursor();
+            return true;
+        }
+        if (!FindFoldRange(first, &last)) {
+            return false;
+        }
+    }
+    if (AddFold(first, last)) {
+        TheDoc.cursor_r = first;
+        SetDocRowsDirty(first, first);
+        ScrollToCursor();
+        UpdateCursor();
+        return true;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Redraws from row first down after the rows first to last were replaced,
+// and puts the cursor at the start of row first
+// ---------------------------------------------------------------------------
+static void ReplacedRows(uint16_t first, uint16_t last, uint16_t old_last_row)
+{
+    ClearMarkedText();
+    TheDoc.cursor_r = first;
+    TheDoc.cursor_c = 0;
+    if (TheDoc.last_row == old_last_row) { // same number of rows
+        SetDocRowsDirty(first, last);
+    } else { // everything below the replaced rows shifted
+        SetDocRowsDirty(first, DOC_ROWS);
+    }
+    ScrollToCursor();
+    UpdateCursor();
+}
+
+// ---------------------------------------------------------------------------
+// Joins the marked rows, or the cursor row and the one below it
+// ---------------------------------------------------------------------------
+bool JoinMarkedLines(void)
+{
+    uint16_t first, last;
+    uint16_t old_last_row = TheDoc.last_row;
+    GetMarkedRows(&first, &last);
+    if (first == last) {
+        last++;
+    }
+    if (JoinRows(first, last)) {
+        ReplacedRows(first, first, old_last_row);
+        return true;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Reflows the marked rows, or the paragraph around the cursor row, where
+// paragraphs are separated by blank rows
+// ---------------------------------------------------------------------------
+bool ReflowMarkedLines(uint8_t width)
+{
+    uint16_t first, last;
+    uint16_t old_last_row = TheDoc.last_row;
+    GetMarkedRows(&first, &last);
+    if (mark_state != MARKED) {
+        while (first > 0 && !BlankRow(first-1)) {
+            first--;
+        }
+        while (last < TheDoc.last_row && !BlankRow(last+1)) {
+            last++;
+        }
+    }
+    if (ReflowRows(first, last, width)) {
+        ReplacedRows(first, last, old_last_row);
+        return true;
+    }
+    return false;
+}
+
 // ---------------------------------------------------------------------------
 // p_popup is NULL, unless a popup is overlapping display
 // ---------------------------------------------------------------------------
@@ -424,6 +1728,12 @@ void * get_popup(void)
 void set_popup(void * popup)
 {
     p_popup = popup;
+    if (popup == NULL && OverlayOpen()) { // plane 1 back to the cursor bar
+        CloseOverlay();
+        cur_inverted = false;
+        PlaceCursor(false, 0, 0);
+        xregn( 1, 0, 1, 4, 3, 3, cursor_struct, 1);
+    }
 }
 
 // ---------------------------------------------------------------------------
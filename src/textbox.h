@@ -11,6 +11,26 @@
 
 #define INSERT_CURSOR 178 // 179 // '|'
 #define CLIPBOARD_SIZE 1024
+#define NOT_DIRTY 0xFF // dirty_c0 of a clean row
+#define NO_SIGNATURE 0 // sig of a row_shown that must be drawn
+#define GUTTER_W 4 // line number gutter width, digits and a space
+#define NO_LINE_NUM 0xFFFF // gutter_num of a row whose gutter must be drawn
+#define NUM_PANES 2 // the textbox can be split in two panes over the doc
+#define SCROLLBAR_W 1 // scrollbar width, in the display's last column
+#define NO_BAR_CELL 0 // bar_cell of a scrollbar cell that must be drawn
+#define NO_BAR_H 0 // bar_h of a scrollbar that must be drawn
+#define MAP_SEGMENTS 0x7F // map_n's number of segments
+#define MAP_FOLDED 0x80 // and its flag for a fold's first row, hiding the rest
+
+typedef struct row_shown { // what a display row shows, exactly but its text
+    uint16_t sig; // hash of the text
+    uint16_t R; // doc row,
+    uint8_t s; // its segment,
+    uint8_t a; // the marked cells a to b-1,
+    uint8_t b;
+    uint8_t lex; // the lexer state it's colored from,
+    bool folded; // and if it's a fold's first row
+} row_shown_t;
 
 typedef struct textbox {
     uint8_t r;
@@ -20,17 +40,60 @@ typedef struct textbox {
     uint8_t bg;
     uint8_t fg;
     bool in_focus;
-    bool row_dirty[DOC_ROWS_DISPLAYED]; // if display row needs redrawing
+    uint8_t ring; // display text rows ring the pane scrolls in
+    uint16_t offset_r; // doc row shown at the top of the pane
+    uint8_t offset_s; // and its wrapped segment shown there
+    uint16_t cursor_r; // doc cursor, kept while another pane is active
+    uint16_t cursor_c;
+    uint8_t dirty_c0[DOC_ROWS_DISPLAYED]; // display row's dirty columns are
+    uint8_t dirty_c1[DOC_ROWS_DISPLAYED]; // c0 to c1, none if c0 > c1
+    row_shown_t row_shown[DOC_ROWS_DISPLAYED]; // what display row shows
+    uint16_t gutter_num[DOC_ROWS_DISPLAYED]; // line number shown, 0 if none
+    uint16_t bar_offset_r; // offset_r, last_row, h and bookmarks the
+    uint16_t bar_last_row; // scrollbar was drawn for
+    uint8_t bar_h;
+    uint16_t bar_marks[NUM_BOOKMARKS];
+    uint8_t bar_cell[DOC_ROWS_DISPLAYED]; // scrollbar cell shown on each row
+    uint16_t map_R[DOC_ROWS_DISPLAYED]; // doc row each display row shows,
+    uint8_t map_s[DOC_ROWS_DISPLAYED]; // the segment of it, if wrapped,
+    uint8_t map_n[DOC_ROWS_DISPLAYED]; // and its number of segments, and MAP_FOLDED
 } textbox_t;
 
-extern textbox_t TheTextbox;
+extern textbox_t ThePanes[NUM_PANES];
+extern textbox_t * TheTextbox; // the active pane, with the cursor
 extern char TheClipboard[CLIPBOARD_SIZE];
 
 void InitTextbox(void);
 void UpdateCursor();
 void UpdateTextboxFocus(bool has_focus);
-void UpdateTextbox(); // Called by main loop periodically to redraw document in textbox
+void UpdateTextbox(); // Called by main loop every frame to redraw document in textbox
 void SetAllTextboxRowsDirty(void);
+void RedrawAllPanes(void);
+void SetTextboxRowDirty(textbox_t * tb, uint8_t r);
+void SetDocSpanDirty(uint16_t R, uint8_t c0, uint8_t c1);
+void SetDocRowsDirty(uint16_t first, uint16_t last);
+void SetTextboxOffset(uint16_t offset);
+void SetSoftWrap(bool wrap);
+bool SoftWrap(void);
+bool MoveCursorLine(bool down);
+bool FoldMarkedLines(void);
+uint16_t DocRowAt(uint8_t row);
+uint16_t DocColAt(uint8_t row, uint8_t col);
+void GlideTextboxOffset(uint16_t offset);
+void GlideTextbox(int16_t n);
+void FinishGlide(void);
+uint16_t TextboxScrollTarget(void);
+void SetSmoothScroll(bool smooth);
+bool SmoothScroll(void);
+void ScrollToCursor(void);
+void ShowLineNumbers(bool show);
+void ShowScrollbar(bool show);
+bool ScrollbarShown(void);
+bool ScrollbarPressed(uint8_t row, uint8_t col);
+void SplitTextbox(bool split);
+bool TextboxSplit(void);
+void ActivatePane(uint8_t i);
+bool ActivatePaneAt(uint8_t row);
 
 void StartMarkingText(void);
 bool MarkingText(int16_t cur_row, int16_t cur_col);
@@ -41,6 +104,13 @@ bool CopyMarkedTextToClipboard(void);
 bool CutMarkedText(void);
 bool PasteTextFromClipboard(void);
 
+bool GotoDocRow(uint16_t R);
+bool MoveMarkedLines(bool up);
+bool DuplicateMarkedLines(void);
+bool DeleteMarkedLines(void);
+bool JoinMarkedLines(void);
+bool ReflowMarkedLines(uint8_t width);
+
 void * get_popup(void); // NULL, unless popup is overlapping display
 void set_popup(void * popup);
 